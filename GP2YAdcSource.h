@@ -0,0 +1,91 @@
+#ifndef GP2Y_ADC_SOURCE_H
+#define GP2Y_ADC_SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class GP2YAdcSource;
+
+/**
+ * Plain function reading a sample of the source, see GP2YAdcSource::getIsrReadFunction()
+ *
+ * @param GP2YAdcSource *source
+ * @param uint8_t pin
+ * @return uint16_t raw sample
+ */
+typedef uint16_t (*GP2YIsrReadFunction)(GP2YAdcSource *source, uint8_t pin);
+
+/**
+ * Source of raw samples for GP2YDustSensor.
+ * Implement it to read the sensor output through an external converter (SPI/I2C ADC),
+ * a DMA driven ADC or a test double. read() is called 280us after the LED is turned on,
+ * so it must return quickly (well under the 40us left of the 320us pulse is ideal).
+ * When the source is used by GP2YTimerEngine, read() runs in interrupt context.
+ * On ESP8266 the timer engine only runs with a source declared safe by isIsrSafe(),
+ * and calls it through the function returned by getIsrReadFunction() instead of read().
+ * Remember to set the matching resolution and reference voltage on the sensor
+ * (setAdcResolution(), setAdcReferenceVoltage()).
+ */
+class GP2YAdcSource
+{
+    public:
+        virtual ~GP2YAdcSource() {}
+
+        /**
+         * Called from GP2YDustSensor::begin()
+         */
+        virtual void begin() {}
+
+        /**
+         * @param uint8_t pin the analogReadPin given to the sensor
+         * @return uint16_t raw sample
+         */
+        virtual uint16_t read(uint8_t pin) = 0;
+
+        /**
+         * Return true when the source can be read in an interrupt while the flash cache is disabled:
+         * placed in IRAM (GP2Y_ISR_ATTR) and calling nothing from flash. Required by GP2YTimerEngine on ESP8266,
+         * where the timer1 interrupt can fire during flash writes and WiFi activity.
+         * A virtual call reads the vtable, which the compiler places in flash, so there an IRAM read() still
+         * crashes when called through the class: the engine uses getIsrReadFunction() instead.
+         * True by default when getIsrReadFunction() returns a function
+         *
+         * @return bool
+         */
+        virtual bool isIsrSafe()
+        {
+            return this->getIsrReadFunction() != NULL;
+        }
+
+        /**
+         * Return a plain function placed in IRAM (GP2Y_ISR_ATTR) reading one sample, used
+         * from the timer interrupt on ESP8266 (also for the burst mode) so no vtable is read there.
+         * It is resolved once when GP2YTimerEngine starts, e.g.:
+         *   static GP2Y_ISR_ATTR uint16_t readIsr(GP2YAdcSource *source, uint8_t pin) { return ((MyAdc *)source)->convert(pin); }
+         * with convert() a non virtual method placed in IRAM
+         *
+         * @return GP2YIsrReadFunction NULL if the source can't be read from an interrupt
+         */
+        virtual GP2YIsrReadFunction getIsrReadFunction()
+        {
+            return NULL;
+        }
+
+        /**
+         * Take count conversions as fast as possible, used by the burst mode
+         * (see GP2YDustSensor::setBurstMode()). Override it when the converter can do
+         * back to back conversions faster than repeated read() calls (e.g. DMA)
+         *
+         * @param uint8_t pin the analogReadPin given to the sensor
+         * @param uint16_t *samples receives count raw samples
+         * @param uint8_t count
+         */
+        virtual void readBurst(uint8_t pin, uint16_t *samples, uint8_t count)
+        {
+            for (uint8_t i = 0; i < count; i++) {
+                samples[i] = this->read(pin);
+            }
+        }
+};
+
+#endif
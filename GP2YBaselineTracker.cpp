@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "GP2YBaselineTracker.h"
+#include "GP2YChecksum.h"
+
+static const uint16_t STATE_MAGIC = 0x5442; // "BT"
+// magic + checksum
+static const uint8_t STATE_HEADER_SIZE = 4;
+
+/**
+ * @param uint16_t readingsPerBucket - readings in each bucket, e.g. 3600 for 1h buckets reading every second
+ * @param uint8_t bucketCount - buckets in the window, max 24
+ */
+GP2YBaselineTracker::GP2YBaselineTracker(uint16_t readingsPerBucket, uint8_t bucketCount)
+{
+    this->readingsPerBucket = readingsPerBucket ? readingsPerBucket : 1;
+
+    if (bucketCount < 1) {
+        bucketCount = 1;
+    } else if (bucketCount > MAX_BUCKETS) {
+        bucketCount = MAX_BUCKETS;
+    }
+    this->bucketCount = bucketCount;
+
+    this->reset();
+}
+
+void GP2YBaselineTracker::reset()
+{
+    this->bucketReadings = 0;
+    this->bucketMin = NO_VALUE;
+    this->bucketSequence = 0;
+    this->dequeFront = 0;
+    this->dequeSize = 0;
+}
+
+/**
+ * Add a reading. Every reading advances the window, only candidates (readings inside the
+ * zero dust voltage range of the sensor) can become the baseline.
+ *
+ * @param uint32_t avgRaw averaged raw ADC value, in 1/16 of an ADC count
+ * @param bool isCandidate
+ */
+void GP2YBaselineTracker::addReading(uint32_t avgRaw, bool isCandidate)
+{
+    if (isCandidate && avgRaw < this->bucketMin) {
+        this->bucketMin = avgRaw;
+    }
+
+    this->bucketReadings++;
+    if (this->bucketReadings >= this->readingsPerBucket) {
+        this->closeBucket();
+    }
+}
+
+void GP2YBaselineTracker::closeBucket()
+{
+    this->bucketSequence++;
+
+    // drop the buckets leaving the window
+    while (this->dequeSize && (uint8_t)(this->bucketSequence - this->dequeSequences[this->dequeFront]) >= this->bucketCount) {
+        this->dequeFront = (this->dequeFront + 1) % MAX_BUCKETS;
+        this->dequeSize--;
+    }
+
+    if (this->bucketMin != NO_VALUE) {
+        // drop the buckets with a higher minimum, they can never be the window minimum again
+        while (this->dequeSize) {
+            uint8_t back = (this->dequeFront + this->dequeSize - 1) % MAX_BUCKETS;
+            if (this->dequeValues[back] < this->bucketMin) {
+                break;
+            }
+            this->dequeSize--;
+        }
+
+        uint8_t slot = (this->dequeFront + this->dequeSize) % MAX_BUCKETS;
+        this->dequeValues[slot] = this->bucketMin;
+        this->dequeSequences[slot] = this->bucketSequence;
+        this->dequeSize++;
+    }
+
+    this->bucketReadings = 0;
+    this->bucketMin = NO_VALUE;
+}
+
+/**
+ * @return bool true once a full bucket with candidates has been seen
+ */
+bool GP2YBaselineTracker::hasBaseline()
+{
+    return this->dequeSize > 0;
+}
+
+/**
+ * Rolling minimum over the window, including the current bucket
+ *
+ * @return uint32_t baseline raw value, in 1/16 of an ADC count, NO_VALUE if there is none yet
+ */
+uint32_t GP2YBaselineTracker::getBaseline()
+{
+    if (!this->dequeSize) {
+        return NO_VALUE;
+    }
+
+    uint32_t baseline = this->dequeValues[this->dequeFront];
+
+    return this->bucketMin < baseline ? this->bucketMin : baseline;
+}
+
+/**
+ * @return uint16_t number of bytes needed by saveState()
+ */
+uint16_t GP2YBaselineTracker::getStateSize()
+{
+    return STATE_HEADER_SIZE + sizeof(GP2YBaselineTracker);
+}
+
+/**
+ * Save the window into a caller provided buffer (e.g. RTC memory), so the baseline survives deep sleep
+ *
+ * @param uint8_t *buffer at least getStateSize() bytes
+ * @param uint16_t size of the buffer
+ * @return uint16_t number of bytes written, 0 if the buffer is too small
+ */
+uint16_t GP2YBaselineTracker::saveState(uint8_t *buffer, uint16_t size)
+{
+    uint16_t stateSize = this->getStateSize();
+
+    if (!buffer || size < stateSize) {
+        return 0;
+    }
+
+    // the tracker only holds plain values, it is saved as is
+    memcpy(buffer + STATE_HEADER_SIZE, this, sizeof(GP2YBaselineTracker));
+
+    uint16_t magic = STATE_MAGIC;
+    uint16_t checksum = gp2yChecksum(buffer + STATE_HEADER_SIZE, sizeof(GP2YBaselineTracker));
+    memcpy(buffer, &magic, sizeof(magic));
+    memcpy(buffer + sizeof(magic), &checksum, sizeof(checksum));
+
+    return stateSize;
+}
+
+/**
+ * Restore the window saved by saveState()
+ *
+ * @param const uint8_t *buffer
+ * @param uint16_t size of the buffer
+ * @return bool false if the state is invalid or was saved with a different bucket size or count
+ */
+bool GP2YBaselineTracker::restoreState(const uint8_t *buffer, uint16_t size)
+{
+    uint16_t magic;
+    uint16_t checksum;
+    GP2YBaselineTracker state;
+
+    if (!buffer || size < this->getStateSize()) {
+        return false;
+    }
+
+    memcpy(&magic, buffer, sizeof(magic));
+    memcpy(&checksum, buffer + sizeof(magic), sizeof(checksum));
+    memcpy(&state, buffer + STATE_HEADER_SIZE, sizeof(GP2YBaselineTracker));
+
+    if (magic != STATE_MAGIC
+        || checksum != gp2yChecksum(buffer + STATE_HEADER_SIZE, sizeof(GP2YBaselineTracker))
+        || state.readingsPerBucket != this->readingsPerBucket
+        || state.bucketCount != this->bucketCount
+        || state.dequeFront >= MAX_BUCKETS
+        || state.dequeSize > MAX_BUCKETS) {
+        return false;
+    }
+
+    *this = state;
+
+    return true;
+}
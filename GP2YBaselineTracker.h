@@ -0,0 +1,46 @@
+#ifndef GP2Y_BASELINE_TRACKER_H
+#define GP2Y_BASELINE_TRACKER_H
+
+#include <stdint.h>
+
+/**
+ * Rolling minimum of the sensor output over a long window (24h by default), used as the zero dust baseline.
+ * The window is split into buckets (1h by default); the minimum of every bucket goes through a monotonic deque,
+ * so the rolling minimum is O(1) per reading with a few bytes per bucket.
+ * Values are averaged raw ADC readings, in 1/16 of an ADC count.
+ * Attach it to a sensor with GP2YDustSensor::setBaselineTracker(), which applies the baseline continuously.
+ * The window can be saved with saveState() to survive deep sleep, like the sensor state.
+ */
+class GP2YBaselineTracker
+{
+    private:
+        static const uint8_t MAX_BUCKETS = 24;
+
+        uint16_t readingsPerBucket;
+        uint8_t bucketCount;
+        uint16_t bucketReadings;
+        uint32_t bucketMin;
+        uint8_t bucketSequence;
+        // monotonic deque of bucket minimums, increasing from front to back
+        uint32_t dequeValues[MAX_BUCKETS];
+        uint8_t dequeSequences[MAX_BUCKETS];
+        uint8_t dequeFront;
+        uint8_t dequeSize;
+
+    protected:
+        void closeBucket();
+
+    public:
+        static const uint32_t NO_VALUE = 0xFFFFFFFF;
+
+        GP2YBaselineTracker(uint16_t readingsPerBucket = 3600, uint8_t bucketCount = 24);
+        void reset();
+        void addReading(uint32_t avgRaw, bool isCandidate);
+        bool hasBaseline();
+        uint32_t getBaseline();
+        uint16_t getStateSize();
+        uint16_t saveState(uint8_t *buffer, uint16_t size);
+        bool restoreState(const uint8_t *buffer, uint16_t size);
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef GP2Y_CALIBRATION_H
+#define GP2Y_CALIBRATION_H
+
+#include <stdint.h>
+
+/**
+ * Compile time sensor characteristics, high density correction curve and AQI breakpoints.
+ * Densities in 1/256 ug/m3 (Q8) like GP2YDustReading::densityQ8.
+ */
+
+struct GP2YCurvePoint
+{
+    uint16_t linearDensity; // ug/m3 from the linear conversion
+    uint16_t density;       // ug/m3 actual
+};
+
+struct GP2YSensorCharacteristics
+{
+    float minZeroDustVoltage;
+    float typZeroDustVoltage;
+    float maxZeroDustVoltage;
+    float minSensitivity;
+    float typSensitivity;
+    float maxSensitivity;
+    const GP2YCurvePoint *highDensityCurve;
+    uint8_t highDensityCurvePoints;
+};
+
+struct GP2YAqiBreakpoint
+{
+    uint16_t concentrationLow;  // 1/10 ug/m3
+    uint16_t concentrationHigh; // 1/10 ug/m3
+    uint16_t indexLow;
+    uint16_t indexHigh;
+};
+
+// typical output characteristic of both datasheets: linear up to ~0.5mg/m3, the output then
+// flattens out and saturates around 3.6V, where the linear conversion stops at ~600ug/m3
+static constexpr GP2YCurvePoint GP2Y_HIGH_DENSITY_CURVE[] = {
+    {0, 0},
+    {450, 450},
+    {500, 520},
+    {540, 600},
+    {570, 700},
+    {590, 800}
+};
+
+// indexed by GP2YDustSensorType
+static constexpr GP2YSensorCharacteristics GP2Y_SENSOR_CHARACTERISTICS[] = {
+    // GP2Y1010AU0F
+    // sensitivity: min/typ/max: 0.425 / 0.5 / 0.75
+    // output voltage at no dust: min/typ/max 0v / 0.9v / 1.5v
+    {0, 0.9, 1.5, 0.425, 0.5, 0.75, GP2Y_HIGH_DENSITY_CURVE, sizeof(GP2Y_HIGH_DENSITY_CURVE) / sizeof(GP2YCurvePoint)},
+    // GP2Y1014AU0F
+    // sensitivity: min/typ/max: 0.35 / 0.5 / 0.65
+    // output voltage at no dust: min/typ/max: 0.1v / 0.6v / 1.1v
+    {0.1, 0.6, 1.1, 0.35, 0.5, 0.65, GP2Y_HIGH_DENSITY_CURVE, sizeof(GP2Y_HIGH_DENSITY_CURVE) / sizeof(GP2YCurvePoint)}
+};
+
+// US EPA PM2.5 AQI breakpoints (2024 revision), concentrations truncated to 0.1ug/m3
+static constexpr GP2YAqiBreakpoint GP2Y_AQI_BREAKPOINTS[] = {
+    {0, 90, 0, 50},
+    {91, 354, 51, 100},
+    {355, 554, 101, 150},
+    {555, 1254, 151, 200},
+    {1255, 2254, 201, 300},
+    {2255, 3254, 301, 500}
+};
+
+static const uint8_t GP2Y_AQI_BREAKPOINT_COUNT = sizeof(GP2Y_AQI_BREAKPOINTS) / sizeof(GP2YAqiBreakpoint);
+static const uint16_t GP2Y_AQI_MAX = 500;
+
+/**
+ * Piecewise linear interpolation in a curve, clamped to its last point
+ *
+ * @param uint32_t densityQ8
+ * @param const GP2YCurvePoint *curve points with increasing linearDensity
+ * @param uint8_t points
+ * @return uint32_t corrected density Q8
+ */
+inline uint32_t gp2yApplyCurve(uint32_t densityQ8, const GP2YCurvePoint *curve, uint8_t points)
+{
+    for (uint8_t i = 1; i < points; i++) {
+        uint32_t high = (uint32_t)curve[i].linearDensity << 8;
+
+        if (densityQ8 <= high) {
+            uint32_t low = (uint32_t)curve[i - 1].linearDensity << 8;
+            int32_t span = curve[i].density - curve[i - 1].density;
+
+            return ((uint32_t)curve[i - 1].density << 8)
+                + (int32_t)(densityQ8 - low) * span / (curve[i].linearDensity - curve[i - 1].linearDensity);
+        }
+    }
+
+    return (uint32_t)curve[points - 1].density << 8;
+}
+
+/**
+ * US EPA air quality index of a PM2.5 concentration, in integer math.
+ * The index is defined on 24h averages of PM2.5, use it with the matching average
+ * (e.g. GP2YDustAggregator), the Sharp sensors don't separate PM2.5 from larger particles
+ *
+ * @param uint32_t densityQ8 concentration in 1/256 ug/m3
+ * @return uint16_t AQI between 0 and 500
+ */
+inline uint16_t gp2yAqi(uint32_t densityQ8)
+{
+    // truncate to 0.1ug/m3 as specified
+    uint32_t concentration = (densityQ8 * 10) >> 8;
+
+    for (uint8_t i = 0; i < GP2Y_AQI_BREAKPOINT_COUNT; i++) {
+        const GP2YAqiBreakpoint &breakpoint = GP2Y_AQI_BREAKPOINTS[i];
+
+        if (concentration <= breakpoint.concentrationHigh) {
+            uint32_t indexSpan = breakpoint.indexHigh - breakpoint.indexLow;
+            uint32_t concentrationSpan = breakpoint.concentrationHigh - breakpoint.concentrationLow;
+            uint32_t offset = concentration > breakpoint.concentrationLow ? concentration - breakpoint.concentrationLow : 0;
+
+            // round to nearest
+            return breakpoint.indexLow + (offset * indexSpan * 2 + concentrationSpan) / (concentrationSpan * 2);
+        }
+    }
+
+    return GP2Y_AQI_MAX;
+}
+
+#endif
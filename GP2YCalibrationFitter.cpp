@@ -0,0 +1,146 @@
+#include "GP2YCalibrationFitter.h"
+
+GP2YCalibrationFitter::GP2YCalibrationFitter()
+{
+    this->reset();
+}
+
+void GP2YCalibrationFitter::reset()
+{
+    this->count = 0;
+    this->meanVoltage = 0;
+    this->meanDensity = 0;
+    this->voltageDeviations = 0;
+    this->densityDeviations = 0;
+    this->coDeviations = 0;
+}
+
+/**
+ * Add a pair of co-located values, averaged over the same period
+ *
+ * @param float voltage - scaled sensor output voltage, in volts
+ * @param float referenceDensity - reference instrument density, in ug/m3
+ */
+void GP2YCalibrationFitter::addPair(float voltage, float referenceDensity)
+{
+    this->count++;
+
+    float voltageDelta = voltage - this->meanVoltage;
+    float densityDelta = referenceDensity - this->meanDensity;
+
+    this->meanVoltage += voltageDelta / this->count;
+    this->meanDensity += densityDelta / this->count;
+
+    // one delta before and one after the mean update keeps the sums exact
+    this->voltageDeviations += voltageDelta * (voltage - this->meanVoltage);
+    this->densityDeviations += densityDelta * (referenceDensity - this->meanDensity);
+    this->coDeviations += voltageDelta * (referenceDensity - this->meanDensity);
+}
+
+/**
+ * Add a sensor reading (GP2YDustSensor::getDustReading()) with the reference density over the same period.
+ * Keep the readings in the linear range (below ~450 ug/m3) for a meaningful fit
+ *
+ * @param const GP2YDustReading &reading
+ * @param float referenceDensity - reference instrument density, in ug/m3
+ */
+void GP2YCalibrationFitter::addReading(const GP2YDustReading &reading, float referenceDensity)
+{
+    this->addPair(reading.voltageMicrovolts / 1e6, referenceDensity);
+}
+
+/**
+ * @return uint32_t number of pairs added
+ */
+uint32_t GP2YCalibrationFitter::getCount()
+{
+    return this->count;
+}
+
+/**
+ * @return bool true with MIN_PAIRS pairs spread over some voltage range and a positive slope
+ */
+bool GP2YCalibrationFitter::hasFit()
+{
+    return this->count >= MIN_PAIRS && this->voltageDeviations > 0 && this->coDeviations > 0;
+}
+
+/**
+ * @return float ug/m3 per volt, 0 without a fit
+ */
+float GP2YCalibrationFitter::getSlope()
+{
+    if (!this->hasFit()) {
+        return 0;
+    }
+
+    return this->coDeviations / this->voltageDeviations;
+}
+
+/**
+ * @return float ug/m3 at 0 volts
+ */
+float GP2YCalibrationFitter::getOffset()
+{
+    return this->meanDensity - this->getSlope() * this->meanVoltage;
+}
+
+/**
+ * Coefficient of determination of the fit, how much of the reference variation the sensor explains
+ *
+ * @return float between 0 and 1
+ */
+float GP2YCalibrationFitter::getRSquared()
+{
+    if (!this->hasFit() || this->densityDeviations <= 0) {
+        return 0;
+    }
+
+    return this->coDeviations * this->coDeviations / (this->voltageDeviations * this->densityDeviations);
+}
+
+/**
+ * @return float fitted sensitivity in volts/100ug/m3, 0 without a fit
+ */
+float GP2YCalibrationFitter::getSensitivity()
+{
+    if (!this->hasFit()) {
+        return 0;
+    }
+
+    return 100 / this->getSlope();
+}
+
+/**
+ * @return float fitted zero dust voltage, where the reference density is 0
+ */
+float GP2YCalibrationFitter::getZeroDustVoltage()
+{
+    if (!this->hasFit()) {
+        return 0;
+    }
+
+    return -this->getOffset() / this->getSlope();
+}
+
+/**
+ * Set the fitted sensitivity and zero dust voltage (baseline) on a sensor.
+ * The voltages are scaled by the calibration factor of the sensor, keep it unchanged after the fit.
+ * An attached GP2YBaselineTracker keeps moving the baseline afterwards
+ *
+ * @param GP2YDustSensor *sensor
+ * @return bool false without a fit, the sensor is unchanged
+ */
+bool GP2YCalibrationFitter::applyTo(GP2YDustSensor *sensor)
+{
+    if (!this->hasFit()) {
+        return false;
+    }
+
+    float zeroDustVoltage = this->getZeroDustVoltage();
+
+    sensor->setSensitivity(this->getSensitivity());
+    sensor->setBaseline(zeroDustVoltage > 0 ? zeroDustVoltage : 0);
+
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef GP2Y_CALIBRATION_FITTER_H
+#define GP2Y_CALIBRATION_FITTER_H
+
+#include <stdint.h>
+
+#include "GP2YDustSensor.h"
+
+/**
+ * Incremental least squares fit of a reference instrument density against the sensor output voltage,
+ * for calibration in the field during a co-location period.
+ * Welford style running means and co-moments, O(1) memory and no stored samples.
+ * The fit density = slope * voltage + offset gives the sensitivity and the zero dust voltage,
+ * applied to a sensor with applyTo().
+ */
+class GP2YCalibrationFitter
+{
+    private:
+        uint32_t count;
+        float meanVoltage;
+        float meanDensity;
+        // sums of squared deviations and of the deviation products
+        float voltageDeviations;
+        float densityDeviations;
+        float coDeviations;
+
+    public:
+        static const uint8_t MIN_PAIRS = 3;
+
+        GP2YCalibrationFitter();
+        void reset();
+        void addPair(float voltage, float referenceDensity);
+        void addReading(const GP2YDustReading &reading, float referenceDensity);
+        uint32_t getCount();
+        bool hasFit();
+        float getSlope();
+        float getOffset();
+        float getRSquared();
+        float getSensitivity();
+        float getZeroDustVoltage();
+        bool applyTo(GP2YDustSensor *sensor);
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GP2Y_CHECKSUM_H
+#define GP2Y_CHECKSUM_H
+
+#include <stdint.h>
+
+/**
+ * Fletcher-16 checksum, used to validate saved state and stored records
+ */
+inline uint16_t gp2yChecksum(const uint8_t *data, uint16_t size)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+
+    for (uint16_t i = 0; i < size; i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+
+    return (sum2 << 8) | sum1;
+}
+
+#endif
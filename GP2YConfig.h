@@ -0,0 +1,125 @@
+#ifndef GP2Y_CONFIG_H
+#define GP2Y_CONFIG_H
+
+/**
+ * Compile time configuration of the GP2YDustSensor library.
+ * Every option can be overridden from the build flags (e.g. -DGP2Y_TIMER_ENGINE=1)
+ * or by editing this file when using the Arduino IDE.
+ */
+
+/**
+ * Hardware timer pulse engine (GP2YTimerEngine).
+ * Enabled by default on ESP32 (esp_timer) and ESP8266 (timer1).
+ * Disabled on AVR because it defines the Timer1 compare interrupt, which conflicts with
+ * other libraries using Timer1 (Servo, TimerOne)
+ */
+#ifndef GP2Y_TIMER_ENGINE
+    #if defined(ESP32) || defined(ESP8266)
+        #define GP2Y_TIMER_ENGINE 1
+    #else
+        #define GP2Y_TIMER_ENGINE 0
+    #endif
+#endif
+
+/**
+ * Number of raw samples buffered between the timer interrupt and the foreground.
+ * Must be a power of two, max 128. At one sample every 10ms, 32 samples hold 320ms.
+ */
+#ifndef GP2Y_SAMPLE_RING_SIZE
+    #define GP2Y_SAMPLE_RING_SIZE 32
+#endif
+
+/**
+ * Maximum number of ADC conversions taken inside one LED pulse in burst mode, up to GP2Y_MAX_FILTER_SAMPLES
+ */
+#ifndef GP2Y_MAX_BURST_SAMPLES
+    #define GP2Y_MAX_BURST_SAMPLES 8
+#endif
+
+/**
+ * Size of the sample buffer used by the robust reducers in getDustDensity() (median, trimmed mean, Hampel).
+ * Longer readings are reduced in blocks of this size. Max 255, allocated on the stack
+ */
+#ifndef GP2Y_MAX_FILTER_SAMPLES
+    #define GP2Y_MAX_FILTER_SAMPLES 32
+#endif
+
+/**
+ * Number of records GP2YFlashLog buffers in RAM before writing them to the storage in one go.
+ * Higher values mean fewer flash writes but more records lost on power failure (12 bytes each)
+ */
+#ifndef GP2Y_FLASH_LOG_BATCH
+    #define GP2Y_FLASH_LOG_BATCH 8
+#endif
+
+/**
+ * Measure the actual sampling timing: LED on to ADC read offset, ADC conversion time and cycle time
+ * (see GP2YDustSensor::getTimingStats()). Adds a few micros() calls per sample and about 50 bytes per sensor,
+ * nothing at all when disabled
+ */
+#ifndef GP2Y_TIMING_STATS
+    #define GP2Y_TIMING_STATS 0
+#endif
+
+/**
+ * Publish a consistent snapshot of the results after every reading (see GP2YDustSensor::getSnapshot()),
+ * for reading them from another task or core. Enabled by default on the dual core ESP32
+ */
+#ifndef GP2Y_SNAPSHOT
+    #if defined(ESP32)
+        #define GP2Y_SNAPSHOT 1
+    #else
+        #define GP2Y_SNAPSHOT 0
+    #endif
+#endif
+
+/**
+ * Sensor health checks on the samples already taken (see GP2YDustSensor::getStatus()):
+ * stuck ADC, saturation, variance collapse, baseline range and drift. A few compares per sample,
+ * a millis() call per reading and about 50 bytes per sensor, so opt-in on AVR
+ */
+#ifndef GP2Y_DIAGNOSTICS
+    #if defined(__AVR__)
+        #define GP2Y_DIAGNOSTICS 0
+    #else
+        #define GP2Y_DIAGNOSTICS 1
+    #endif
+#endif
+
+/**
+ * Maximum number of readings GP2YSamplingTask delivers at once (ESP32 only)
+ */
+#ifndef GP2Y_TASK_MAX_BATCH
+    #define GP2Y_TASK_MAX_BATCH 16
+#endif
+
+// code called from interrupts must be placed in IRAM on the Espressif chips
+#if defined(ESP32) || defined(ESP8266)
+    #define GP2Y_ISR_ATTR IRAM_ATTR
+#else
+    #define GP2Y_ISR_ATTR
+#endif
+
+// statistics shared with the sampling. On ESP32 the writers run in the esp_timer task or GP2YSamplingTask,
+// possibly on the other core where noInterrupts() does not exclude them, so both sides take a spinlock.
+// Elsewhere the writer is the interrupt or the foreground itself, the reader disabling the interrupts is enough
+#if defined(ESP32)
+    #define GP2Y_ENTER_CRITICAL(lock) portENTER_CRITICAL(lock)
+    #define GP2Y_EXIT_CRITICAL(lock) portEXIT_CRITICAL(lock)
+    #define GP2Y_ENTER_WRITER(lock) portENTER_CRITICAL(lock)
+    #define GP2Y_EXIT_WRITER(lock) portEXIT_CRITICAL(lock)
+#else
+    #define GP2Y_ENTER_CRITICAL(lock) noInterrupts()
+    #define GP2Y_EXIT_CRITICAL(lock) interrupts()
+    #define GP2Y_ENTER_WRITER(lock)
+    #define GP2Y_EXIT_WRITER(lock)
+#endif
+
+// order memory accesses between the interrupt/other core and the foreground
+#if defined(ESP32)
+    #define GP2Y_MEMORY_BARRIER() __sync_synchronize()
+#else
+    #define GP2Y_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+#endif
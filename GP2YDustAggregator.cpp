@@ -0,0 +1,269 @@
+#include <string.h>
+
+#include "GP2YDustAggregator.h"
+#include "GP2YChecksum.h"
+
+static const uint16_t STATE_MAGIC = 0x4133; // "3A", the values are in 1/16 ug/m3 since version 3
+// magic + checksum
+static const uint8_t STATE_HEADER_SIZE = 4;
+
+/**
+ * @param uint16_t readingsPerMinute - how many times getDustDensity() is called each minute
+ * Example: 60 if you read the density each second
+ */
+GP2YDustAggregator::GP2YDustAggregator(uint16_t readingsPerMinute)
+{
+    this->readingsPerMinute = readingsPerMinute ? readingsPerMinute : 1;
+    this->reset();
+}
+
+/**
+ * Clear all windows
+ */
+void GP2YDustAggregator::reset()
+{
+    this->currentMinuteSum = 0;
+    this->currentMinuteReadings = 0;
+    this->nextMinute = 0;
+    this->minuteCount = 0;
+    this->minutesSinceHour = 0;
+    this->quarterSum = 0;
+    this->hourSum = 0;
+    this->nextHour = 0;
+    this->hourCount = 0;
+    this->daySum = 0;
+
+    for (uint8_t i = 0; i < MINUTES_PER_HOUR; i++) {
+        this->minutes[i] = 0;
+    }
+
+    for (uint8_t i = 0; i < HOURS_PER_DAY; i++) {
+        this->hours[i] = 0;
+    }
+}
+
+/**
+ * Add a dust density reading
+ *
+ * @param uint16_t dustDensity in ug/m3
+ */
+void GP2YDustAggregator::addReading(uint16_t dustDensity)
+{
+    this->addReadingQ8((uint32_t)dustDensity << 8);
+}
+
+/**
+ * Add a full resolution dust density reading. Called by GP2YDustSensor for every reading when attached with setAggregator()
+ *
+ * @param uint32_t densityQ8 in 1/256 ug/m3
+ */
+void GP2YDustAggregator::addReadingQ8(uint32_t densityQ8)
+{
+    const uint8_t shift = 8 - FRACTION_BITS;
+    uint32_t value = (densityQ8 + (1 << (shift - 1))) >> shift;
+
+    this->currentMinuteSum += value > 0xFFFF ? 0xFFFF : value;
+    this->currentMinuteReadings++;
+
+    if (this->currentMinuteReadings >= this->readingsPerMinute) {
+        this->addMinute((this->currentMinuteSum + this->currentMinuteReadings / 2) / this->currentMinuteReadings);
+        this->currentMinuteSum = 0;
+        this->currentMinuteReadings = 0;
+    }
+}
+
+void GP2YDustAggregator::addMinute(uint16_t minuteAverage)
+{
+    uint8_t quarterStart = (this->nextMinute + MINUTES_PER_HOUR - QUARTER_MINUTES) % MINUTES_PER_HOUR;
+
+    // evict the minute leaving each window before the slot is overwritten
+    if (this->minuteCount >= QUARTER_MINUTES) {
+        this->quarterSum -= this->minutes[quarterStart];
+    }
+
+    if (this->minuteCount >= MINUTES_PER_HOUR) {
+        this->hourSum -= this->minutes[this->nextMinute];
+    } else {
+        this->minuteCount++;
+    }
+
+    this->minutes[this->nextMinute] = minuteAverage;
+    this->quarterSum += minuteAverage;
+    this->hourSum += minuteAverage;
+
+    this->nextMinute++;
+    if (this->nextMinute >= MINUTES_PER_HOUR) {
+        this->nextMinute = 0;
+    }
+
+    // the hour sum now holds exactly the hour that just ended
+    this->minutesSinceHour++;
+    if (this->minutesSinceHour >= MINUTES_PER_HOUR) {
+        this->minutesSinceHour = 0;
+        this->addHour((this->hourSum + MINUTES_PER_HOUR / 2) / MINUTES_PER_HOUR);
+    }
+}
+
+void GP2YDustAggregator::addHour(uint16_t hourAverage)
+{
+    if (this->hourCount >= HOURS_PER_DAY) {
+        this->daySum -= this->hours[this->nextHour];
+    } else {
+        this->hourCount++;
+    }
+
+    this->hours[this->nextHour] = hourAverage;
+    this->daySum += hourAverage;
+
+    this->nextHour++;
+    if (this->nextHour >= HOURS_PER_DAY) {
+        this->nextHour = 0;
+    }
+}
+
+/**
+ * Get the average dust density over a window of completed minutes / hours.
+ * Until a window is full the average of the available data is returned,
+ * falling back to the next shorter window when there is no data yet
+ * (e.g. the 24h average during the first hour is the average since start).
+ *
+ * @param GP2YAggregateWindow window
+ * @return uint16_t average dust density in ug/m3
+ */
+uint16_t GP2YDustAggregator::getAverage(GP2YAggregateWindow window)
+{
+    return (this->getAverageQ8(window) + 128) >> 8;
+}
+
+/**
+ * Average like getAverage(), without rounding (use it with gp2yAqi())
+ *
+ * @param GP2YAggregateWindow window
+ * @return uint32_t average dust density in 1/256 ug/m3
+ */
+uint32_t GP2YDustAggregator::getAverageQ8(GP2YAggregateWindow window)
+{
+    if (window == GP2Y_WINDOW_24_HOURS && this->hourCount) {
+        return averageQ8(this->daySum, this->hourCount);
+    }
+
+    if (window == GP2Y_WINDOW_15_MINUTES && this->minuteCount) {
+        uint8_t count = this->minuteCount < QUARTER_MINUTES ? this->minuteCount : QUARTER_MINUTES;
+        return averageQ8(this->quarterSum, count);
+    }
+
+    // 1h window, or 24h window without a complete hour
+    if (window != GP2Y_WINDOW_1_MINUTE && this->minuteCount) {
+        return averageQ8(this->hourSum, this->minuteCount);
+    }
+
+    if (this->minuteCount) {
+        return averageQ8(this->minutes[(this->nextMinute + MINUTES_PER_HOUR - 1) % MINUTES_PER_HOUR], 1);
+    }
+
+    // no complete minute yet
+    if (this->currentMinuteReadings) {
+        return averageQ8(this->currentMinuteSum, this->currentMinuteReadings);
+    }
+
+    return 0;
+}
+
+/**
+ * @param uint32_t sum of values in 1/16 ug/m3
+ * @param uint32_t count
+ * @return uint32_t average in 1/256 ug/m3, rounded to nearest
+ */
+uint32_t GP2YDustAggregator::averageQ8(uint32_t sum, uint32_t count)
+{
+    const uint8_t shift = 8 - FRACTION_BITS;
+
+    // split the division so the sum can't overflow when shifted
+    return ((sum / count) << shift) + (((sum % count) << shift) + count / 2) / count;
+}
+
+/**
+ * @param GP2YAggregateWindow window
+ * @return bool true if the window holds its full duration of data
+ */
+bool GP2YDustAggregator::isWindowFull(GP2YAggregateWindow window)
+{
+    switch (window) {
+        case GP2Y_WINDOW_1_MINUTE:
+            return this->minuteCount > 0;
+        case GP2Y_WINDOW_15_MINUTES:
+            return this->minuteCount >= QUARTER_MINUTES;
+        case GP2Y_WINDOW_1_HOUR:
+            return this->minuteCount >= MINUTES_PER_HOUR;
+        case GP2Y_WINDOW_24_HOURS:
+            return this->hourCount >= HOURS_PER_DAY;
+    }
+
+    return false;
+}
+
+/**
+ * @return uint16_t number of bytes needed by saveState()
+ */
+uint16_t GP2YDustAggregator::getStateSize()
+{
+    return STATE_HEADER_SIZE + sizeof(GP2YDustAggregator);
+}
+
+/**
+ * Save all the windows into a caller provided buffer (e.g. RTC memory), so they survive deep sleep
+ *
+ * @param uint8_t *buffer at least getStateSize() bytes
+ * @param uint16_t size of the buffer
+ * @return uint16_t number of bytes written, 0 if the buffer is too small
+ */
+uint16_t GP2YDustAggregator::saveState(uint8_t *buffer, uint16_t size)
+{
+    uint16_t stateSize = this->getStateSize();
+
+    if (!buffer || size < stateSize) {
+        return 0;
+    }
+
+    // the aggregator only holds plain values, it is saved as is
+    memcpy(buffer + STATE_HEADER_SIZE, this, sizeof(GP2YDustAggregator));
+
+    uint16_t magic = STATE_MAGIC;
+    uint16_t checksum = gp2yChecksum(buffer + STATE_HEADER_SIZE, sizeof(GP2YDustAggregator));
+    memcpy(buffer, &magic, sizeof(magic));
+    memcpy(buffer + sizeof(magic), &checksum, sizeof(checksum));
+
+    return stateSize;
+}
+
+/**
+ * Restore the windows saved by saveState()
+ *
+ * @param const uint8_t *buffer
+ * @param uint16_t size of the buffer
+ * @return bool false if the state is invalid or was saved with a different readingsPerMinute
+ */
+bool GP2YDustAggregator::restoreState(const uint8_t *buffer, uint16_t size)
+{
+    uint16_t magic;
+    uint16_t checksum;
+    GP2YDustAggregator state;
+
+    if (!buffer || size < this->getStateSize()) {
+        return false;
+    }
+
+    memcpy(&magic, buffer, sizeof(magic));
+    memcpy(&checksum, buffer + sizeof(magic), sizeof(checksum));
+    memcpy(&state, buffer + STATE_HEADER_SIZE, sizeof(GP2YDustAggregator));
+
+    if (magic != STATE_MAGIC
+        || checksum != gp2yChecksum(buffer + STATE_HEADER_SIZE, sizeof(GP2YDustAggregator))
+        || state.readingsPerMinute != this->readingsPerMinute) {
+        return false;
+    }
+
+    *this = state;
+
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef GP2Y_DUST_AGGREGATOR_H
+#define GP2Y_DUST_AGGREGATOR_H
+
+#include <stdint.h>
+
+enum GP2YAggregateWindow
+{
+    GP2Y_WINDOW_1_MINUTE,
+    GP2Y_WINDOW_15_MINUTES,
+    GP2Y_WINDOW_1_HOUR,
+    GP2Y_WINDOW_24_HOURS
+};
+
+/**
+ * Tiered dust density aggregator.
+ * Readings are summed into minute averages, kept in a 60 slot ring, which roll up into hour averages
+ * kept in a 24 slot ring. Running sums are maintained for each window so every average is O(1),
+ * using about 200 bytes in total instead of the 172KB needed by a 24h running average at 1Hz.
+ * Like the running average, the windows are based on the number of readings,
+ * so call getDustDensity() at a constant interval.
+ * Values are kept in 1/16 ug/m3 like the running average, so the averages are not quantized to whole readings.
+ */
+class GP2YDustAggregator
+{
+    private:
+        static const uint8_t MINUTES_PER_HOUR = 60;
+        static const uint8_t QUARTER_MINUTES = 15;
+        static const uint8_t HOURS_PER_DAY = 24;
+        static const uint8_t FRACTION_BITS = 4;
+
+        uint16_t readingsPerMinute;
+        uint32_t currentMinuteSum;
+        uint16_t currentMinuteReadings;
+        uint16_t minutes[MINUTES_PER_HOUR];
+        uint8_t nextMinute;
+        uint8_t minuteCount;
+        uint8_t minutesSinceHour;
+        uint32_t quarterSum;
+        uint32_t hourSum;
+        uint16_t hours[HOURS_PER_DAY];
+        uint8_t nextHour;
+        uint8_t hourCount;
+        uint32_t daySum;
+
+    protected:
+        void addMinute(uint16_t minuteAverage);
+        void addHour(uint16_t hourAverage);
+        static uint32_t averageQ8(uint32_t sum, uint32_t count);
+
+    public:
+        GP2YDustAggregator(uint16_t readingsPerMinute = 60);
+        void reset();
+        void addReading(uint16_t dustDensity);
+        void addReadingQ8(uint32_t densityQ8);
+        uint16_t getAverage(GP2YAggregateWindow window);
+        uint32_t getAverageQ8(GP2YAggregateWindow window);
+        bool isWindowFull(GP2YAggregateWindow window);
+        uint16_t getStateSize();
+        uint16_t saveState(uint8_t *buffer, uint16_t size);
+        bool restoreState(const uint8_t *buffer, uint16_t size);
+};
+
+#endif
@@ -1,6 +1,157 @@
-#include <Arduino.h>
+#include <string.h>
 
+#include "GP2YHal.h"
 #include "GP2YDustSensor.h"
+#include "GP2YDustAggregator.h"
+#include "GP2YBaselineTracker.h"
+#include "GP2YThresholdMonitor.h"
+#include "GP2YChecksum.h"
+
+/**
+ * Convert factor to a multiplier and a right shift, so x * factor = (x * multiplier) >> shift.
+ * Uses the largest shift that keeps the product in 32 bits for x up to maxInput, for the best precision.
+ */
+static void toFixedPoint(float factor, float maxInput, uint32_t &multiplier, uint8_t &shift)
+{
+    shift = 0;
+    while (shift < 31 && factor * maxInput * ((uint32_t)1 << (shift + 1)) < 4.0e9) {
+        shift++;
+    }
+
+    multiplier = factor * ((uint32_t)1 << shift) + 0.5;
+}
+
+/**
+ * Compact sensor state saved by saveState(), followed by the running average buffer
+ */
+struct GP2YDustSensorState
+{
+    uint16_t magic;
+    uint16_t checksum;
+    uint8_t version;
+    uint8_t type;
+    uint16_t runningAverageCount;
+    float zeroDustVoltage;
+    float currentBaselineCandidate;
+    uint32_t minDustRaw;
+    uint32_t runningAverageSum;
+    uint16_t runningAverageSamples;
+    uint16_t nextRunningAverageCounter;
+    int32_t exponentialAverage;
+    int32_t adaptiveMean;
+    uint32_t adaptiveVariance;
+    uint32_t adaptiveInterval;
+    uint16_t adaptiveSamples;
+    uint16_t readCount;
+    uint16_t lastDustDensity;
+    uint8_t flags;
+    uint8_t stableReadings;
+};
+
+static const uint16_t STATE_MAGIC = 0x5932; // "2Y"
+static const uint8_t STATE_VERSION = 2;
+static const uint8_t STATE_HAS_BASELINE_CANDIDATE = 1;
+static const uint8_t STATE_HAS_EXPONENTIAL_AVERAGE = 2;
+static const uint8_t STATE_HAS_ADAPTIVE_STATISTICS = 4;
+
+static GP2Y_ISR_ATTR void sortSamples(uint16_t *samples, uint8_t count)
+{
+    // insertion sort, count is small
+    for (uint8_t i = 1; i < count; i++) {
+        uint16_t sample = samples[i];
+        uint8_t j = i;
+        while (j > 0 && samples[j - 1] > sample) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = sample;
+    }
+}
+
+/**
+ * @param uint16_t *samples sorted samples
+ * @return uint32_t median, in 1/16 of an ADC count
+ */
+static GP2Y_ISR_ATTR uint32_t sortedMedian(uint16_t *samples, uint8_t count)
+{
+    if (count & 1) {
+        return (uint32_t)samples[count / 2] << 4;
+    }
+
+    return ((uint32_t)samples[count / 2 - 1] + samples[count / 2]) << 3;
+}
+
+/**
+ * Reduce count raw samples to a single value
+ * - mean
+ * - median
+ * - trimmed mean: mean without the lowest and highest 25% of the samples
+ * - Hampel filter: mean of the samples, replacing the ones further than 3 scaled MADs
+ *   (median absolute deviation) from the median with the median
+ *
+ * @param uint16_t *samples, reordered by every reducer except the mean
+ * @return uint32_t reduced value, in 1/16 of an ADC count
+ */
+// the Hampel filter buffers the deviations of up to GP2Y_MAX_FILTER_SAMPLES samples, bursts included
+static_assert(GP2Y_MAX_BURST_SAMPLES <= GP2Y_MAX_FILTER_SAMPLES, "GP2Y_MAX_BURST_SAMPLES can't exceed GP2Y_MAX_FILTER_SAMPLES");
+
+static GP2Y_ISR_ATTR uint32_t reduceSamples(uint16_t *samples, uint8_t count, GP2YReducer reducer)
+{
+    uint32_t total = 0;
+
+    switch (reducer) {
+        case GP2Y_REDUCE_MEDIAN:
+            sortSamples(samples, count);
+            return sortedMedian(samples, count);
+        case GP2Y_REDUCE_TRIMMED_MEAN: {
+            sortSamples(samples, count);
+            uint8_t trim = count / 4;
+            for (uint8_t i = trim; i < count - trim; i++) {
+                total += samples[i];
+            }
+
+            return (total << 4) / (count - 2 * trim);
+        }
+        case GP2Y_REDUCE_HAMPEL: {
+            uint16_t deviations[GP2Y_MAX_FILTER_SAMPLES];
+
+            sortSamples(samples, count);
+            uint32_t median = sortedMedian(samples, count);
+            uint16_t roundedMedian = (median + 8) >> 4;
+
+            for (uint8_t i = 0; i < count; i++) {
+                deviations[i] = samples[i] > roundedMedian ? samples[i] - roundedMedian : roundedMedian - samples[i];
+            }
+            sortSamples(deviations, count);
+
+            // 3 * 1.4826 * MAD, at least 1 count so the ADC quantization noise is kept
+            uint32_t threshold = (((sortedMedian(deviations, count) * 4448) / 1000) + 8) >> 4;
+            if (threshold < 1) {
+                threshold = 1;
+            }
+
+            // the deviations were sorted, compute them again
+            for (uint8_t i = 0; i < count; i++) {
+                uint16_t deviation = samples[i] > roundedMedian ? samples[i] - roundedMedian : roundedMedian - samples[i];
+                if (deviation <= threshold) {
+                    total += (uint32_t)samples[i] << 4;
+                } else {
+                    total += median;
+                }
+            }
+
+            return total / count;
+        }
+        default:
+            break;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        total += samples[i];
+    }
+
+    return (total << 4) / count;
+}
 
 /**
  * @param GP2YDustSensorType type use one of the two supported types
@@ -14,42 +165,151 @@ GP2YDustSensor::GP2YDustSensor(GP2YDustSensorType type,
                                uint8_t ledOutputPin,
                                uint8_t analogReadPin,
                                uint16_t runningAverageCount)
+{
+    this->init(type, ledOutputPin, analogReadPin);
+    this->initRunningAverage(runningAverageCount ? new int16_t[runningAverageCount] : NULL, runningAverageCount);
+    this->ownsRunningAverageBuffer = true;
+}
+
+/**
+ * Allocation-free constructor, the running average uses a buffer provided by the caller
+ * (a global or static array), so there is no heap use. See also GP2YStaticDustSensor
+ *
+ * @param GP2YDustSensorType type use one of the two supported types
+ * @param uint8_t ledOutputPin - the GPIO pin powering up the Sharp IR LED
+ * @param uint8_t analogReadPin - the analog input pin connected from the Sharp analog output (Vo).
+ * @param int16_t *runningAverageBuffer - storage for runningAverageCount samples, must outlive the sensor
+ * @param uint16_t runningAverageCount - number of samples taken for the running average.
+ * use 0 to disable running average
+ */
+GP2YDustSensor::GP2YDustSensor(GP2YDustSensorType type,
+                               uint8_t ledOutputPin,
+                               uint8_t analogReadPin,
+                               int16_t *runningAverageBuffer,
+                               uint16_t runningAverageCount)
+{
+    this->init(type, ledOutputPin, analogReadPin);
+    this->initRunningAverage(runningAverageBuffer, runningAverageBuffer ? runningAverageCount : 0);
+    this->ownsRunningAverageBuffer = false;
+}
+
+/**
+ * Constructor using an exponential moving average (first order IIR filter) instead of the running average buffer.
+ * It only needs a few bytes of state whatever the time constant, handy on memory-constrained AVR boards.
+ * getRunningAverage() returns the exponential average.
+ *
+ * @param GP2YDustSensorType type use one of the two supported types
+ * @param uint8_t ledOutputPin - the GPIO pin powering up the Sharp IR LED
+ * @param uint8_t analogReadPin - the analog input pin connected from the Sharp analog output (Vo).
+ * @param float timeConstant - time constant of the average in seconds, ~63% of a step change is followed after it
+ * @param float readInterval - seconds between two readings (calls to getDustDensity())
+ */
+GP2YDustSensor::GP2YDustSensor(GP2YDustSensorType type,
+                               uint8_t ledOutputPin,
+                               uint8_t analogReadPin,
+                               float timeConstant,
+                               float readInterval)
+{
+    this->init(type, ledOutputPin, analogReadPin);
+    this->initRunningAverage(NULL, 0);
+    this->ownsRunningAverageBuffer = false;
+
+    // alpha = 1 - e^(-readInterval / timeConstant), in 1/65536
+    float alpha = timeConstant > 0 ? 1 - exp(-readInterval / timeConstant) : 1;
+    this->exponentialAverageAlpha = alpha * 65536 + 0.5;
+    if (this->exponentialAverageAlpha < 1) {
+        this->exponentialAverageAlpha = 1;
+    }
+    this->useExponentialAverage = true;
+}
+
+void GP2YDustSensor::init(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin)
 {
     this->ledOutputPin = ledOutputPin;
     this->analogReadPin = analogReadPin;
     this->type = type;
-    this->sensitivity = 0.5; // default sensitivity from datasheet
     this->nextRunningAverageCounter = 0;
     this->hasBaselineCandidate = false;
     this->readCount = 0;
+    this->measurementState = MEASUREMENT_IDLE;
+    this->measurementTotal = 0;
+    this->measurementSampleCount = 0;
+    this->measurementSamplesTaken = 0;
+    this->pulseStartTime = 0;
+    memset(&this->lastReading, 0, sizeof(this->lastReading));
+    this->sampleRing = NULL;
+    this->timerLedOn = false;
+    this->lastRingOverruns = 0;
+#if defined(ESP32)
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    this->statisticsLock = unlocked;
+#endif
+#if GP2Y_SNAPSHOT
+    this->snapshotSequence = 0;
+    memset(&this->snapshot, 0, sizeof(this->snapshot));
+    this->snapshotCandidateRaw = 0;
+#endif
+#if GP2Y_TIMING_STATS
+    this->resetTimingStats();
+#endif
+    this->aggregator = NULL;
+    this->thresholdMonitor = NULL;
+    this->adcSource = NULL;
+    this->isrRead = NULL;
+    this->burstSamples = 1;
+    this->burstReducer = GP2Y_REDUCE_MEAN;
+    this->sampleReducer = GP2Y_REDUCE_MEAN;
+    this->useExponentialAverage = false;
+    this->hasExponentialAverage = false;
+    this->exponentialAverageAlpha = 0;
+    this->exponentialAverage = 0;
+    this->adaptiveSampling = false;
+    this->hasAdaptiveStatistics = false;
+    this->adaptiveMinSamples = this->adaptiveMaxSamples = this->adaptiveSamples = 20;
+    this->adaptiveMinInterval = this->adaptiveMaxInterval = this->adaptiveInterval = 1000;
+    this->adaptiveChangeThreshold = 5;
+    this->adaptiveMean = 0;
+    this->adaptiveVariance = 0;
+    this->stableReadings = 0;
+    this->baselineTracker = NULL;
+    this->baselineStepRaw = 0;
+    this->temperature = 25;
+    this->referenceTemperature = 25;
+    this->temperatureCoefficient = 0;
+    this->humidity = 0;
+    this->humidityKappa = 0;
+    this->temperatureOffsetRaw = 0;
     
-    switch (type) {
-        case GP2Y1010AU0F:
-            // sensitivity: min/typ/max: 0.425 / 0.5 / 0.75 
-            // output voltage at no dust: min/typ/max 0v / 0.9v / 1.5v
-            
-            this->minZeroDustVoltage = 0;
-            this->typZeroDustVoltage = 0.9;
-            this->maxZeroDustVoltage = 1.5;
-            this->zeroDustVoltage = this->minDustVoltage = this->typZeroDustVoltage;
-            break;
-        case GP2Y1014AU0F:
-            // sensitivity: min/typ/max: 0.35 / 0.5 / 0.65 
-            // output voltage at no dust: min/typ/max: 0.1v / 0.6v / 1.1v
-
-            this->minZeroDustVoltage = 0.1;
-            this->typZeroDustVoltage = 0.6;
-            this->maxZeroDustVoltage = 1.1;
-            this->zeroDustVoltage = this->minDustVoltage = this->typZeroDustVoltage;
-            break;
-    }
+    this->characteristics = &GP2Y_SENSOR_CHARACTERISTICS[type];
+    this->minZeroDustVoltage = this->characteristics->minZeroDustVoltage;
+    this->typZeroDustVoltage = this->characteristics->typZeroDustVoltage;
+    this->maxZeroDustVoltage = this->characteristics->maxZeroDustVoltage;
+    this->zeroDustVoltage = this->typZeroDustVoltage;
+    this->sensitivity = this->characteristics->typSensitivity;
+    this->highDensityCorrection = false;
 
     this->calibrationFactor = 1;
     this->currentBaselineCandidate = this->typZeroDustVoltage;
+    this->adcResolution = 10;
+    this->maxAdc = 1023;
+    this->adcReferenceVoltage = 5.0;
+    this->voltageDividerRatio = 1;
+    this->updateConversion();
+    this->minDustRaw = this->voltageToRaw(this->typZeroDustVoltage);
+#if GP2Y_DIAGNOSTICS
+    this->maxBaselineDrift = 0.005;
+    this->skipSampleChecks = false;
+    this->resetDiagnostics();
+#endif
+}
 
-    this->runningAverageCount = runningAverageCount;
+void GP2YDustSensor::initRunningAverage(int16_t *buffer, uint16_t count)
+{
+    this->runningAverageBuffer = buffer;
+    this->runningAverageCount = count;
+    this->runningAverageSum = 0;
+    this->runningAverageSamples = 0;
     if (this->runningAverageCount) {
-        this->runningAverageBuffer = new int16_t[this->runningAverageCount];
         // init with -1
         for (uint16_t i = 0; i < this->runningAverageCount; i++) {
             this->runningAverageBuffer[i] = -1;
@@ -63,6 +323,10 @@ GP2YDustSensor::GP2YDustSensor(GP2YDustSensorType type,
 void GP2YDustSensor::begin()
 {
     pinMode(this->ledOutputPin, OUTPUT);
+
+    if (this->adcSource) {
+        this->adcSource->begin();
+    }
 }
 
 /**
@@ -74,6 +338,7 @@ void GP2YDustSensor::begin()
 void GP2YDustSensor::setBaseline(float zeroDustVoltage)
 {
     this->zeroDustVoltage = zeroDustVoltage;
+    this->updateConversion();
 }
 
 float GP2YDustSensor::getBaseline()
@@ -94,16 +359,27 @@ float GP2YDustSensor::getBaselineCandidate()
         return this->currentBaselineCandidate;
     }
 
-    float candidate = this->minDustVoltage;
+    float candidate = this->rawToVoltage(this->minDustRaw);
     // reset min voltage to enable selection of new candidate
-    this->minDustVoltage = this->maxZeroDustVoltage;
-    this->currentBaselineCandidate = this->minDustVoltage;
+    this->minDustRaw = this->maxZeroDustRaw;
+    this->currentBaselineCandidate = this->maxZeroDustVoltage;
     readCount = 0; // reset read sample count
     hasBaselineCandidate = false;
 
     return candidate;
 }
 
+/**
+ * Returns the baseline candidate like getBaselineCandidate(), but leaves the candidate
+ * selection running. Does not modify the sensor state
+ *
+ * @return float baseline candidate scaled voltage
+ */
+float GP2YDustSensor::peekBaselineCandidate()
+{
+    return this->hasBaselineCandidate ? this->rawToVoltage(this->minDustRaw) : this->currentBaselineCandidate;
+}
+
 /**
  * Set sensitivity in volts/100ug/m3
  * Typical sensitivity is 0.5V, set by default
@@ -115,6 +391,7 @@ float GP2YDustSensor::getBaselineCandidate()
 void GP2YDustSensor::setSensitivity(float sensitivity)
 {
     this->sensitivity = sensitivity;
+    this->updateConversion();
 }
 
 /**
@@ -125,21 +402,96 @@ float GP2YDustSensor::getSensitivity()
     return this->sensitivity;
 }
 
+/**
+ * Correct the readings above ~450ug/m3, where the sensor output flattens out before saturating,
+ * with the piecewise linear curve of the sensor type (see GP2YCalibration.h).
+ * Readings then go up to 800ug/m3 instead of ~600ug/m3
+ *
+ * @param bool enabled
+ */
+void GP2YDustSensor::setHighDensityCorrection(bool enabled)
+{
+    this->highDensityCorrection = enabled;
+}
+
+/**
+ * US EPA PM2.5 air quality index of the last reading.
+ * The index is defined on 24h averages, use gp2yAqi() with an aggregated density for a reportable value
+ *
+ * @return uint16_t AQI between 0 and 500
+ */
+uint16_t GP2YDustSensor::getAqi()
+{
+    return this->lastReading.aqi;
+}
+
+/**
+ * Read the sensor output from the ADC source, or analogRead() if none was set
+ *
+ * @return uint16_t raw ADC value
+ */
+GP2Y_ISR_ATTR uint16_t GP2YDustSensor::readAdc()
+{
+    uint16_t value;
+
+    if (this->burstSamples > 1) {
+        uint16_t samples[GP2Y_MAX_BURST_SAMPLES];
+
+        if (this->isrRead) {
+            for (uint8_t i = 0; i < this->burstSamples; i++) {
+                samples[i] = this->isrRead(this->adcSource, this->analogReadPin);
+            }
+        } else if (this->adcSource) {
+            this->adcSource->readBurst(this->analogReadPin, samples, this->burstSamples);
+        } else {
+            for (uint8_t i = 0; i < this->burstSamples; i++) {
+                samples[i] = analogRead(this->analogReadPin);
+            }
+        }
+
+        // round to the nearest ADC count
+        value = (reduceSamples(samples, this->burstSamples, this->burstReducer) + 8) >> 4;
+    } else if (this->isrRead) {
+        value = this->isrRead(this->adcSource, this->analogReadPin);
+    } else if (this->adcSource) {
+        value = this->adcSource->read(this->analogReadPin);
+    } else {
+        value = analogRead(this->analogReadPin);
+    }
+
+#if GP2Y_DIAGNOSTICS
+    if (!this->skipSampleChecks) {
+        this->checkSample(value);
+    }
+#endif
+
+    return value;
+}
+
 /**
  * Raw sensor reading from ADC
  * 
- * @return uint16_t value between 0 - 1024
+ * @return uint16_t value between 0 - maxAdc (1023 for the default 10 bit ADC)
  */
 uint16_t GP2YDustSensor::readDustRawOnce()
 {
     // Turn on the dust sensor LED by setting digital pin LOW.
     digitalWrite(this->ledOutputPin, LOW);
+#if GP2Y_TIMING_STATS
+    uint32_t ledOnTime = micros();
+#endif
 
     // Wait 0.28ms before taking a reading of the output voltage as per spec.
     delayMicroseconds(280);
 
+#if GP2Y_TIMING_STATS
+    uint32_t readStartTime = micros();
+#endif
     // Record the output voltage. This operation takes around 100 microseconds.
-    uint16_t VoRaw = analogRead(this->analogReadPin);
+    uint16_t VoRaw = this->readAdc();
+#if GP2Y_TIMING_STATS
+    this->recordTiming(ledOnTime, readStartTime, micros());
+#endif
 
     // Turn the dust sensor LED off by setting digital pin HIGH.
     digitalWrite(this->ledOutputPin, HIGH);
@@ -150,121 +502,1489 @@ uint16_t GP2YDustSensor::readDustRawOnce()
 /**
  * Get average dust density between numSamples in ug/m3
  * With the default value of numSamples (20) the reading should take 200ms
+ * When the timer engine is running (see GP2YTimerEngine) the samples are taken from
+ * the ring buffer filled by the timer interrupt instead
  * 
  * @return uint16_t dust density between 0 and 600 ug/m3
  */
 uint16_t GP2YDustSensor::getDustDensity(uint16_t numSamples)
 {
     uint32_t total = 0;
-    uint16_t avgRaw;
+
+    if (!numSamples) {
+        numSamples = 1;
+    }
+
+    if (this->sampleReducer != GP2Y_REDUCE_MEAN) {
+        return this->processRawAverage(this->readReducedSamples(numSamples), numSamples);
+    }
+
+    if (this->sampleRing) {
+        return this->processSamples(this->drainSampleRing(numSamples), numSamples);
+    }
   
-    for (uint8_t i = 0; i < numSamples; i++) {
+    // 65535 samples of 16 bits still fit in the 32 bit total
+    for (uint16_t i = 0; i < numSamples; i++) {
         total += this->readDustRawOnce();
         // Wait for remainder of the 10ms cycle = 10000 - 280 - 100 microseconds.
         delayMicroseconds(9620);
     }
 
-    avgRaw = total / numSamples;
+    return this->processSamples(total, numSamples);
+}
 
-    // we scale up the read ADC voltage to the sensor's 5V output range
-    // so we can interpret the results based on voltage
-    // we assume a 10 bit ADC resolution currently given by analogRead()
-    float scaledVoltage = avgRaw * (5.0 / 1024) * calibrationFactor;
+/**
+ * Long integration which stops as soon as the result is precise enough:
+ * samples are taken until the 95% confidence interval of the mean is within
+ * +/- maxError ug/m3, or maxSamples were taken. Useful in clean air, where the
+ * ADC noise is large compared to the signal. Always uses the mean of the samples.
+ * The number of samples taken is in getLastReading().sampleCount
+ *
+ * @param float maxError - half width of the confidence interval, in ug/m3
+ * @param uint16_t maxSamples - 1000 samples take 10s
+ * @param uint16_t minSamples - taken before the first check, so the variance estimate is meaningful
+ * @return uint16_t dust density between 0 and 600 ug/m3
+ */
+uint16_t GP2YDustSensor::getDustDensityUntil(float maxError, uint16_t maxSamples, uint16_t minSamples)
+{
+    uint32_t total = 0;
+    int32_t deviationSum = 0;
+    uint64_t deviationSquareSum = 0;
+    uint16_t first = 0;
+    uint16_t count = 0;
 
-    // determine new baseline candidate
-    if (scaledVoltage < this->minDustVoltage && scaledVoltage >= minZeroDustVoltage && scaledVoltage <= maxZeroDustVoltage) {
-        this->minDustVoltage = scaledVoltage;
+    if (!maxSamples) {
+        maxSamples = 1;
     }
 
-    uint16_t dustDensity;
+    if (minSamples < 2) {
+        minSamples = 2;
+    }
 
-    if (scaledVoltage < zeroDustVoltage) {
-        dustDensity = 0;
-    } else {
-        // taken from the graph, at 0.4mg dust density we should have 3.05 volts
-        // 3.05v ................ 0.4
-        // scaledVoltage ........ ?
-        // ? = scaledVoltage * 0.4 / 3.05
-        // We will try to be smarter and adjust the graph
-        // according to the zero dust voltage offset and sensitivity
-        // typical zero dust is 0.6V but I observed 0.4V on my sensor
-        // sensor sensitivy is 0.5V according to the datasheet
-        // dustDensity is expressed in ug/m3
-        dustDensity = (scaledVoltage - zeroDustVoltage) / this->sensitivity * 100;
+    // ug/m3 per ADC count, from the fixed point conversion (density Q8 = avg Q4 * multiplier >> shift)
+    float densityPerCount = ldexp((float)this->densityMultiplier, -(int)this->densityShift - RAW_FRACTION_BITS);
+    // (1.96 * sd / sqrt(n))^2 <= maxError^2 with sd in ADC counts
+    float limit = (maxError / densityPerCount) * (maxError / densityPerCount) / (1.96f * 1.96f);
+
+    if (this->sampleRing) {
+        this->flushStaleSamples();
     }
 
-    if (this->runningAverageCount) {
-        this->updateRunningAverage(dustDensity);
+    while (count < maxSamples) {
+        uint16_t sample = this->takeSample();
+
+        // deviations from the first sample are small, so their squares can't overflow
+        if (!count) {
+            first = sample;
+        }
+        int32_t deviation = (int32_t)sample - first;
+
+        total += sample;
+        deviationSum += deviation;
+        deviationSquareSum += (uint64_t)((int64_t)deviation * deviation);
+        count++;
+
+        if (count >= minSamples) {
+            float mean = (float)deviationSum / count;
+            float variance = ((float)deviationSquareSum - mean * deviationSum) / (count - 1);
+
+            if (variance / count <= limit) {
+                break;
+            }
+        }
     }
 
-    if (!hasBaselineCandidate) {
-        readCount++;
-        if (readCount > BASELINE_CANDIDATE_MIN_READINGS) {
-            hasBaselineCandidate = true;
+    return this->processSamples(total, count);
+}
+
+/**
+ * Capture raw ADC samples for offline analysis or custom processing, one every 10ms.
+ * The samples don't update the running average, the baseline candidate or any other statistics.
+ * When the timer engine is running the samples are taken from its ring buffer and the timestamps
+ * are the times they were consumed, use GP2YSampleRing::peek() for zero-copy access instead.
+ *
+ * @param uint16_t *samples receives count raw samples
+ * @param uint16_t count
+ * @param uint32_t *timestamps optional, receives the micros() time of each sample
+ * @return uint16_t number of samples captured
+ */
+uint16_t GP2YDustSensor::captureRawSamples(uint16_t *samples, uint16_t count, uint32_t *timestamps)
+{
+    if (!samples) {
+        return 0;
+    }
+
+    if (this->sampleRing) {
+        this->flushStaleSamples();
+    }
+#if GP2Y_DIAGNOSTICS
+    // the captured samples are not part of a reading, they would skew its spread and saturation checks
+    this->skipSampleChecks = !this->sampleRing;
+#endif
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t sampleTime;
+
+        if (this->sampleRing) {
+            while (!this->sampleRing->pop(samples[i])) {
+                yield();
+            }
+            sampleTime = micros();
+        } else {
+            sampleTime = micros() + SAMPLE_DELAY_US;
+            samples[i] = this->readDustRawOnce();
+            // Wait for remainder of the 10ms cycle = 10000 - 280 - 100 microseconds.
+            delayMicroseconds(9620);
+        }
+
+        if (timestamps) {
+            timestamps[i] = sampleTime;
         }
     }
 
-    return dustDensity;
+#if GP2Y_DIAGNOSTICS
+    this->skipSampleChecks = false;
+#endif
+
+    return count;
 }
 
 /**
- * Get the running average value of dust density using runningAverageCount number of samples
- * Example: If you read the density with getDustDensity() each second and runningAverageCount is 60 (default)
- * you will get a running average for 1 minute
- * 
- * @return uint16_t average dust density value between 0 and 600 ug/m3
- * 
+ * Start a non-blocking measurement of numSamples.
+ * Call poll() as often as possible from loop() until it returns true (or isReady() is true),
+ * then read the result with getLastDensity().
+ * Between the LED pulses the CPU is free, so WiFi and other work can run during the measurement.
+ * Do not call getDustDensity() while a non-blocking measurement is in progress.
+ *
+ * @param uint16_t numSamples number of 10ms LED cycles to average
  */
-uint16_t GP2YDustSensor::getRunningAverage()
+void GP2YDustSensor::startMeasurement(uint16_t numSamples)
 {
-    if (!this->runningAverageCount) {
-        return -1;
-        //throw std::runtime_error("Running average was disabled from constructor. Use runningAverageCount to specify the size.");
+    if (this->measurementState == MEASUREMENT_LED_ON) {
+        // never leave the LED on when a measurement is restarted
+        digitalWrite(this->ledOutputPin, HIGH);
+    }
+
+    if (this->measurementState == MEASUREMENT_IDLE) {
+        // first measurement, the first LED pulse can start right away
+        this->pulseStartTime = micros() - SAMPLE_CYCLE_US;
+    }
+
+    if (this->sampleRing) {
+        // only use samples taken after the measurement was started
+        this->sampleRing->flush();
     }
 
-  float runningAverage = 0;
-  uint16_t sampleCount = 0;
+    this->measurementTotal = 0;
+    this->measurementSampleCount = numSamples ? numSamples : 1;
+    this->measurementSamplesTaken = 0;
+    // wait for the previous cycle to end, so pulses are never closer than 10ms
+    this->measurementState = MEASUREMENT_CYCLE_WAIT;
+}
+
+/**
+ * Advance the non-blocking measurement by at most one step (LED on, ADC read + LED off).
+ * The pulse timing depends on how often this is called, so call it frequently,
+ * ideally at least every 100 microseconds while waiting for the sample point.
+ *
+ * @return bool true when the measurement is complete
+ */
+bool GP2YDustSensor::poll()
+{
+    if (this->sampleRing) {
+        // the timer engine does the pulses, just collect its samples
+        uint16_t sample;
+
+        while (this->measurementState == MEASUREMENT_CYCLE_WAIT && this->sampleRing->pop(sample)) {
+            this->measurementTotal += sample;
+            this->measurementSamplesTaken++;
 
-    for (uint16_t i = 0; i < this->runningAverageCount; i++) {
-        if (this->runningAverageBuffer[i] != -1) {
-            runningAverage += this->runningAverageBuffer[i];
-            sampleCount++;
+            if (this->measurementSamplesTaken >= this->measurementSampleCount) {
+                this->processSamples(this->measurementTotal, this->measurementSamplesTaken);
+                this->measurementState = MEASUREMENT_READY;
+            }
         }
+
+        return this->measurementState == MEASUREMENT_READY;
     }
 
-    if (sampleCount == 0) {
-        return 0;
+    uint32_t elapsed = micros() - this->pulseStartTime;
+
+    switch (this->measurementState) {
+        case MEASUREMENT_CYCLE_WAIT:
+            if (elapsed >= SAMPLE_CYCLE_US) {
+                // Turn on the dust sensor LED by setting digital pin LOW.
+                digitalWrite(this->ledOutputPin, LOW);
+                this->pulseStartTime = micros();
+                this->measurementState = MEASUREMENT_LED_ON;
+            }
+            break;
+        case MEASUREMENT_LED_ON:
+            if (elapsed >= SAMPLE_DELAY_US) {
+#if GP2Y_TIMING_STATS
+                uint32_t readStartTime = micros();
+                this->measurementTotal += this->readAdc();
+                this->recordTiming(this->pulseStartTime, readStartTime, micros());
+#else
+                this->measurementTotal += this->readAdc();
+#endif
+                digitalWrite(this->ledOutputPin, HIGH);
+                this->measurementSamplesTaken++;
+
+                if (this->measurementSamplesTaken >= this->measurementSampleCount) {
+                    this->processSamples(this->measurementTotal, this->measurementSamplesTaken);
+                    this->measurementState = MEASUREMENT_READY;
+                } else {
+                    this->measurementState = MEASUREMENT_CYCLE_WAIT;
+                }
+            }
+            break;
+        default:
+            break;
     }
-    
-    runningAverage /= sampleCount;
 
-    return round(runningAverage);
-} 
+    return this->measurementState == MEASUREMENT_READY;
+}
 
 /**
- * Set a calibration factor to improve accuracy
- * Calibrate against known source / precision instrument
- * 
- * @oaram float slope
+ * @return bool true if the last non-blocking measurement has completed
  */
-void GP2YDustSensor::setCalibrationFactor(float slope)
+bool GP2YDustSensor::isReady()
 {
-    this->calibrationFactor = slope;
+    return this->measurementState == MEASUREMENT_READY;
 }
 
-GP2YDustSensor::~GP2YDustSensor()
+/**
+ * Get the dust density computed by the last completed measurement (blocking or non-blocking)
+ *
+ * @return uint16_t dust density between 0 and 600 ug/m3
+ */
+uint16_t GP2YDustSensor::getLastDensity()
+{
+    return this->lastReading.density;
+}
+
+/**
+ * Read numSamples like getDustDensity() and get the full result: fractional density,
+ * scaled voltage, averaged raw value and sample count, all from the same pass
+ *
+ * @param uint16_t numSamples
+ * @return GP2YDustReading
+ */
+GP2YDustReading GP2YDustSensor::getDustReading(uint16_t numSamples)
+{
+    this->getDustDensity(numSamples);
+
+    return this->lastReading;
+}
+
+/**
+ * Get the full result of the last completed measurement (blocking or non-blocking)
+ *
+ * @return GP2YDustReading
+ */
+GP2YDustReading GP2YDustSensor::getLastReading()
+{
+    return this->lastReading;
+}
+
+#if GP2Y_SNAPSHOT
+/**
+ * Consistent copy of the results of the last reading, safe to call from another task or core
+ * while the sensor is sampling (the other getters are not, they may see a half updated state).
+ * Lock-free: the readings are published under a sequence lock, the sampling task never waits
+ * and this retries in the rare case a reading was published during the copy.
+ * Enable with GP2Y_SNAPSHOT (see GP2YConfig.h), on by default on ESP32
+ *
+ * @return GP2YDustSnapshot
+ */
+GP2YDustSnapshot GP2YDustSensor::getSnapshot()
+{
+    GP2YDustSnapshot copy;
+    uint32_t candidateRaw;
+    uint32_t sequence;
+
+    do {
+        // odd while the sampling task writes
+        while ((sequence = this->snapshotSequence) & 1) {
+            yield();
+        }
+        GP2Y_MEMORY_BARRIER();
+        copy = this->snapshot;
+        candidateRaw = this->snapshotCandidateRaw;
+        GP2Y_MEMORY_BARRIER();
+    } while (sequence != this->snapshotSequence);
+
+    if (copy.hasBaselineCandidate) {
+        copy.baselineCandidate = this->rawToVoltage(candidateRaw);
+    }
+
+    return copy;
+}
+
+/**
+ * Publish the results of the reading that just completed
+ */
+void GP2YDustSensor::publishSnapshot()
+{
+    this->snapshotSequence = this->snapshotSequence + 1;
+    GP2Y_MEMORY_BARRIER();
+
+    this->snapshot.reading = this->lastReading;
+    this->snapshot.runningAverage = this->getRunningAverage();
+    this->snapshot.runningAverageQ8 = this->getRunningAverageQ8();
+    this->snapshot.baseline = this->zeroDustVoltage;
+    // converted to volts by the reader, no float math in the sampling task
+    this->snapshot.baselineCandidate = this->currentBaselineCandidate;
+    this->snapshot.hasBaselineCandidate = this->hasBaselineCandidate;
+    this->snapshotCandidateRaw = this->minDustRaw;
+    this->snapshot.readingCount++;
+
+    GP2Y_MEMORY_BARRIER();
+    this->snapshotSequence = this->snapshotSequence + 1;
+}
+#endif
+
+#if GP2Y_TIMING_STATS
+/**
+ * Measured timing of the samples taken since the start or resetTimingStats(),
+ * by getDustDensity(), the non-blocking API and the timer engine.
+ * A sample is late when read more than 100us after the 280us of the datasheet,
+ * a deadline is missed when a pulse starts more than 100us after the end of the 10ms cycle.
+ * Pauses longer than two cycles are the gap between two readings and are not counted as cycles.
+ * Enable with GP2Y_TIMING_STATS (see GP2YConfig.h)
+ *
+ * @return GP2YTimingStats
+ */
+GP2YTimingStats GP2YDustSensor::getTimingStats()
 {
-    if (this->runningAverageBuffer) {
-        delete this->runningAverageBuffer;
+    // the timer engine updates the stats from its interrupt, or its task on ESP32
+    GP2Y_ENTER_CRITICAL(&this->statisticsLock);
+    GP2YTimingStats stats = this->timingStats;
+    uint64_t sampleOffsetSum = this->sampleOffsetSum;
+    uint64_t conversionTimeSum = this->conversionTimeSum;
+    uint64_t cycleTimeSum = this->cycleTimeSum;
+    GP2Y_EXIT_CRITICAL(&this->statisticsLock);
+
+    if (stats.samples) {
+        stats.meanSampleOffset = sampleOffsetSum / stats.samples;
+        stats.meanConversionTime = conversionTimeSum / stats.samples;
+    }
+
+    if (stats.cycles) {
+        stats.meanCycleTime = cycleTimeSum / stats.cycles;
+    }
+
+    if (this->sampleRing) {
+        stats.overruns = this->sampleRing->getOverruns();
     }
+
+    return stats;
 }
 
-void GP2YDustSensor::updateRunningAverage(uint16_t value)
+/**
+ * Restart the timing measurement
+ */
+void GP2YDustSensor::resetTimingStats()
 {
-    this->runningAverageBuffer[this->nextRunningAverageCounter] = value;
+    GP2Y_ENTER_CRITICAL(&this->statisticsLock);
+    memset(&this->timingStats, 0, sizeof(this->timingStats));
+    this->timingStats.minSampleOffset = 0xFFFF;
+    this->timingStats.minConversionTime = 0xFFFF;
+    this->timingStats.minCycleTime = 0xFFFF;
+    this->sampleOffsetSum = 0;
+    this->conversionTimeSum = 0;
+    this->cycleTimeSum = 0;
+    this->hasLastPulse = false;
+    GP2Y_EXIT_CRITICAL(&this->statisticsLock);
+}
 
-    this->nextRunningAverageCounter++;
-    if (this->nextRunningAverageCounter >= this->runningAverageCount) {
-        this->nextRunningAverageCounter = 0; 
+/**
+ * @param uint32_t ledOnTime micros() when the LED was turned on
+ * @param uint32_t readStartTime micros() before the ADC read
+ * @param uint32_t readEndTime micros() after the ADC read
+ */
+GP2Y_ISR_ATTR void GP2YDustSensor::recordTiming(uint32_t ledOnTime, uint32_t readStartTime, uint32_t readEndTime)
+{
+    GP2Y_ENTER_WRITER(&this->statisticsLock);
+
+    GP2YTimingStats &stats = this->timingStats;
+    uint32_t sampleOffset = readStartTime - ledOnTime;
+    uint32_t conversionTime = readEndTime - readStartTime;
+
+    sampleOffset = sampleOffset > 0xFFFF ? 0xFFFF : sampleOffset;
+    conversionTime = conversionTime > 0xFFFF ? 0xFFFF : conversionTime;
+
+    stats.samples++;
+    this->sampleOffsetSum += sampleOffset;
+    this->conversionTimeSum += conversionTime;
+
+    if (sampleOffset < stats.minSampleOffset) {
+        stats.minSampleOffset = sampleOffset;
+    }
+    if (sampleOffset > stats.maxSampleOffset) {
+        stats.maxSampleOffset = sampleOffset;
+    }
+    if (conversionTime < stats.minConversionTime) {
+        stats.minConversionTime = conversionTime;
+    }
+    if (conversionTime > stats.maxConversionTime) {
+        stats.maxConversionTime = conversionTime;
+    }
+    if (sampleOffset > SAMPLE_DELAY_US + TIMING_TOLERANCE_US) {
+        stats.lateSamples++;
+    }
+
+    uint32_t cycleTime = ledOnTime - this->lastPulseTime;
+    if (this->hasLastPulse && cycleTime <= 2 * (uint32_t)SAMPLE_CYCLE_US) {
+        stats.cycles++;
+        this->cycleTimeSum += cycleTime;
+
+        if (cycleTime < stats.minCycleTime) {
+            stats.minCycleTime = cycleTime;
+        }
+        if (cycleTime > stats.maxCycleTime) {
+            stats.maxCycleTime = cycleTime;
+        }
+        if (cycleTime > SAMPLE_CYCLE_US + TIMING_TOLERANCE_US) {
+            stats.missedDeadlines++;
+        }
+    }
+
+    this->lastPulseTime = ledOnTime;
+    this->hasLastPulse = true;
+
+    GP2Y_EXIT_WRITER(&this->statisticsLock);
+}
+#endif
+
+#if GP2Y_DIAGNOSTICS
+/**
+ * Sensor health flags of the last reading, a combination of GP2YStatus bits.
+ * GP2Y_STATUS_OK (0) when nothing looks wrong. Computed from the samples already taken, no extra sampling.
+ * Enable with GP2Y_DIAGNOSTICS (see GP2YConfig.h)
+ *
+ * @return uint8_t
+ */
+uint8_t GP2YDustSensor::getStatus()
+{
+    return this->status;
+}
+
+/**
+ * @return GP2YDiagnostics counters behind the status flags
+ */
+GP2YDiagnostics GP2YDustSensor::getDiagnostics()
+{
+    GP2YDiagnostics diagnostics;
+
+    // the timer engine checks its samples from the interrupt, or its task on ESP32
+    GP2Y_ENTER_CRITICAL(&this->statisticsLock);
+    diagnostics.samples = this->diagnosticSamples;
+    diagnostics.saturatedSamples = this->saturatedSamples;
+    diagnostics.identicalSamples = this->identicalSamples;
+    GP2Y_EXIT_CRITICAL(&this->statisticsLock);
+
+    diagnostics.status = this->status;
+    diagnostics.sampleSpread = this->sampleSpread;
+    diagnostics.collapsedReadings = this->collapsedReadings;
+    diagnostics.lowestVoltage = this->lowestVoltage;
+    diagnostics.baselineDriftRate = this->baselineDriftRate;
+
+    return diagnostics;
+}
+
+/**
+ * Clear the flags and counters, and restart the hourly window
+ */
+void GP2YDustSensor::resetDiagnostics()
+{
+    GP2Y_ENTER_CRITICAL(&this->statisticsLock);
+    this->diagnosticSamples = 0;
+    this->saturatedSamples = 0;
+    this->readingSaturatedSamples = 0;
+    this->lastSample = 0xFFFF;
+    this->identicalSamples = 0;
+    this->readingMinSample = 0xFFFF;
+    this->readingMaxSample = 0;
+    GP2Y_EXIT_CRITICAL(&this->statisticsLock);
+
+    this->status = GP2Y_STATUS_OK;
+    this->sampleSpread = 0;
+    this->collapsedReadings = 0;
+    this->windowStart = millis();
+    this->windowStartBaseline = this->zeroDustVoltage;
+    this->windowMinRaw = 0xFFFFFFFF;
+    this->lowestVoltage = 0;
+    this->baselineDriftRate = 0;
+}
+
+/**
+ * Baseline change rate above which GP2Y_STATUS_BASELINE_DRIFT is set, 0.005V/h by default.
+ * The first hour includes the initial settling of an attached GP2YBaselineTracker
+ *
+ * @param float voltsPerHour
+ */
+void GP2YDustSensor::setMaxBaselineDrift(float voltsPerHour)
+{
+    this->maxBaselineDrift = voltsPerHour;
+}
+
+/**
+ * Per sample checks, called for every ADC read
+ *
+ * @param uint16_t sample raw ADC value
+ */
+GP2Y_ISR_ATTR void GP2YDustSensor::checkSample(uint16_t sample)
+{
+    GP2Y_ENTER_WRITER(&this->statisticsLock);
+
+    this->diagnosticSamples++;
+
+    if (sample >= this->maxAdc) {
+        this->saturatedSamples++;
+        this->readingSaturatedSamples++;
+    }
+
+    if (sample == this->lastSample) {
+        if (this->identicalSamples < 0xFFFF) {
+            this->identicalSamples++;
+        }
+    } else {
+        this->lastSample = sample;
+        this->identicalSamples = 1;
+    }
+
+    if (sample < this->readingMinSample) {
+        this->readingMinSample = sample;
+    }
+    if (sample > this->readingMaxSample) {
+        this->readingMaxSample = sample;
+    }
+
+    GP2Y_EXIT_WRITER(&this->statisticsLock);
+}
+
+/**
+ * Evaluate the status flags at the end of a reading
+ *
+ * @param uint32_t avgRaw averaged raw ADC value at the reference temperature, in 1/16 of an ADC count
+ */
+void GP2YDustSensor::updateDiagnostics(uint32_t avgRaw)
+{
+    GP2Y_ENTER_CRITICAL(&this->statisticsLock);
+    uint16_t readingSaturatedSamples = this->readingSaturatedSamples;
+    uint16_t readingMinSample = this->readingMinSample;
+    uint16_t readingMaxSample = this->readingMaxSample;
+    uint16_t identicalSamples = this->identicalSamples;
+    this->readingSaturatedSamples = 0;
+    this->readingMinSample = 0xFFFF;
+    this->readingMaxSample = 0;
+    GP2Y_EXIT_CRITICAL(&this->statisticsLock);
+
+    uint8_t status = GP2Y_STATUS_OK;
+
+    // a working sensor has a few ADC counts of noise, a flat output is not the pulsed sensor signal
+    if (readingMaxSample >= readingMinSample) {
+        this->sampleSpread = readingMaxSample - readingMinSample;
+
+        if (this->sampleSpread > 1) {
+            this->collapsedReadings = 0;
+        } else if (this->collapsedReadings < 0xFFFF) {
+            this->collapsedReadings++;
+        }
+    }
+
+    if (this->collapsedReadings >= COLLAPSE_READINGS) {
+        status |= GP2Y_STATUS_VARIANCE_COLLAPSE;
+    }
+    if (identicalSamples >= STUCK_SAMPLES) {
+        status |= GP2Y_STATUS_STUCK_ADC;
+    }
+    if (readingSaturatedSamples) {
+        status |= GP2Y_STATUS_SATURATED;
+    }
+
+    if (avgRaw < this->windowMinRaw) {
+        this->windowMinRaw = avgRaw;
+    }
+
+    uint32_t now = millis();
+    uint32_t elapsed = now - this->windowStart;
+
+    if (elapsed >= DIAGNOSTICS_WINDOW_MS) {
+        this->lowestVoltage = this->rawToVoltage(this->windowMinRaw);
+        this->baselineDriftRate = (this->zeroDustVoltage - this->windowStartBaseline) * 3600000.0 / elapsed;
+        this->windowStart = now;
+        this->windowStartBaseline = this->zeroDustVoltage;
+        this->windowMinRaw = 0xFFFFFFFF;
+    }
+
+    // the output never goes below the zero dust voltage, and clean air is below its maximum at least once an hour
+    bool lowestInRange = !this->lowestVoltage
+        || (this->lowestVoltage >= this->minZeroDustVoltage && this->lowestVoltage <= this->maxZeroDustVoltage);
+
+    if (this->zeroDustRaw < this->minZeroDustRaw || this->zeroDustRaw > this->maxZeroDustRaw || !lowestInRange) {
+        status |= GP2Y_STATUS_BASELINE_OUT_OF_RANGE;
+    }
+    if (this->baselineDriftRate > this->maxBaselineDrift || this->baselineDriftRate < -this->maxBaselineDrift) {
+        status |= GP2Y_STATUS_BASELINE_DRIFT;
+    }
+
+    this->status = status;
+}
+#endif
+
+/**
+ * If the ring overflowed since the last reading its content is too old, discard it
+ */
+void GP2YDustSensor::flushStaleSamples()
+{
+    uint16_t overruns = this->sampleRing->getOverruns();
+
+    if (overruns != this->lastRingOverruns) {
+        this->lastRingOverruns = overruns;
+        this->sampleRing->flush();
+    }
+}
+
+/**
+ * Sum numSamples raw readings taken by the timer engine, waiting for the missing ones.
+ *
+ * @return uint32_t sum of the raw readings
+ */
+uint32_t GP2YDustSensor::drainSampleRing(uint16_t numSamples)
+{
+    uint32_t total = 0;
+    uint16_t sample;
+
+    this->flushStaleSamples();
+
+    for (uint16_t i = 0; i < numSamples; i++) {
+        while (!this->sampleRing->pop(sample)) {
+            yield();
+        }
+        total += sample;
+    }
+
+    return total;
+}
+
+/**
+ * Read numSamples raw readings and reduce them with the sample reducer,
+ * in blocks of GP2Y_MAX_FILTER_SAMPLES weighted by their size
+ *
+ * @return uint32_t reduced raw value, in 1/16 of an ADC count
+ */
+uint32_t GP2YDustSensor::readReducedSamples(uint16_t numSamples)
+{
+    uint16_t samples[GP2Y_MAX_FILTER_SAMPLES];
+    // the sum of the reduced values (1/16 counts) weighted by the block size overflows 32 bits on long readings
+    uint64_t total = 0;
+    uint16_t taken = 0;
+
+    if (this->sampleRing) {
+        this->flushStaleSamples();
+    }
+
+    while (taken < numSamples) {
+        uint8_t count = numSamples - taken < GP2Y_MAX_FILTER_SAMPLES ? numSamples - taken : GP2Y_MAX_FILTER_SAMPLES;
+
+        for (uint8_t i = 0; i < count; i++) {
+            samples[i] = this->takeSample();
+        }
+
+        total += (uint64_t)reduceSamples(samples, count, this->sampleReducer) * count;
+        taken += count;
+    }
+
+    return total / numSamples;
+}
+
+/**
+ * Take the next raw sample: from the timer engine ring, waiting for it,
+ * or a blocking read followed by the rest of the 10ms cycle
+ *
+ * @return uint16_t raw sample
+ */
+uint16_t GP2YDustSensor::takeSample()
+{
+    uint16_t sample;
+
+    if (this->sampleRing) {
+        while (!this->sampleRing->pop(sample)) {
+            yield();
+        }
+
+        return sample;
+    }
+
+    sample = this->readDustRawOnce();
+    // Wait for remainder of the 10ms cycle = 10000 - 280 - 100 microseconds.
+    delayMicroseconds(9620);
+
+    return sample;
+}
+
+/**
+ * One step of the timer driven pulse: LED on, or ADC read + LED off.
+ * Called from the timer interrupt by GP2YTimerEngine
+ *
+ * @return uint32_t microseconds until the next step
+ */
+GP2Y_ISR_ATTR uint32_t GP2YDustSensor::onTimerTick()
+{
+    if (!this->timerLedOn) {
+        digitalWrite(this->ledOutputPin, LOW);
+        this->timerLedOn = true;
+#if GP2Y_TIMING_STATS
+        this->timerLedOnTime = micros();
+#endif
+
+        return SAMPLE_DELAY_US;
+    }
+
+#if GP2Y_TIMING_STATS
+    uint32_t readStartTime = micros();
+    this->sampleRing->push(this->readAdc());
+    this->recordTiming(this->timerLedOnTime, readStartTime, micros());
+#else
+    this->sampleRing->push(this->readAdc());
+#endif
+    digitalWrite(this->ledOutputPin, HIGH);
+    this->timerLedOn = false;
+
+    return SAMPLE_CYCLE_US - SAMPLE_DELAY_US;
+}
+
+/**
+ * Convert the sum of numSamples raw readings to dust density and update
+ * the running average and the baseline candidate
+ *
+ * @return uint16_t dust density between 0 and 600 ug/m3
+ */
+uint16_t GP2YDustSensor::processSamples(uint32_t total, uint16_t numSamples)
+{
+    // keep the fractional part of the average, in 1/16 of an ADC count.
+    // total << 4 would overflow with long readings, shift the quotient and the remainder separately
+    uint32_t avgRaw = ((total / numSamples) << RAW_FRACTION_BITS)
+        + ((total % numSamples) << RAW_FRACTION_BITS) / numSamples;
+
+    return this->processRawAverage(avgRaw, numSamples);
+}
+
+/**
+ * Convert an averaged raw reading to dust density and update
+ * the running average and the baseline candidate
+ *
+ * @param uint32_t avgRaw averaged raw ADC value, in 1/16 of an ADC count
+ * @param uint16_t numSamples number of samples averaged
+ * @return uint16_t dust density between 0 and 600 ug/m3
+ */
+uint16_t GP2YDustSensor::processRawAverage(uint32_t avgRaw, uint16_t numSamples)
+{
+    // the baseline is kept at the reference temperature, remove the temperature shift
+    // before the candidate selection and the tracker so it is not applied twice
+    int32_t referenceRaw = (int32_t)avgRaw - this->temperatureOffsetRaw;
+    uint32_t baselineRaw = referenceRaw > 0 ? referenceRaw : 0;
+    bool isCandidate = baselineRaw >= this->minZeroDustRaw && baselineRaw <= this->maxZeroDustRaw;
+
+    // determine new baseline candidate
+    if (isCandidate && baselineRaw < this->minDustRaw) {
+        this->minDustRaw = baselineRaw;
+    }
+
+    if (this->baselineTracker) {
+        this->trackBaseline(baselineRaw, isCandidate);
+    }
+
+    uint16_t dustDensity;
+    uint32_t densityQ8 = 0;
+
+    // the temperature compensation shifts the zero dust voltage
+    int32_t zeroRaw = (int32_t)this->zeroDustRaw + this->temperatureOffsetRaw;
+    if (zeroRaw < 0) {
+        zeroRaw = 0;
+    }
+
+    if (avgRaw < (uint32_t)zeroRaw) {
+        dustDensity = 0;
+    } else {
+        // taken from the graph, at 0.4mg dust density we should have 3.05 volts
+        // 3.05v ................ 0.4
+        // scaledVoltage ........ ?
+        // ? = scaledVoltage * 0.4 / 3.05
+        // We will try to be smarter and adjust the graph
+        // according to the zero dust voltage offset and sensitivity
+        // typical zero dust is 0.6V but I observed 0.4V on my sensor
+        // sensor sensitivy is 0.5V according to the datasheet
+        // dustDensity is expressed in ug/m3
+        // (scaledVoltage - zeroDustVoltage) / sensitivity * 100 is precomputed by updateConversion()
+        // into an offset and a multiplier in ADC counts, which includes the humidity correction
+        densityQ8 = ((avgRaw - zeroRaw) * this->densityMultiplier) >> this->densityShift;
+        if (this->highDensityCorrection) {
+            densityQ8 = gp2yApplyCurve(densityQ8, this->characteristics->highDensityCurve, this->characteristics->highDensityCurvePoints);
+        }
+        dustDensity = densityQ8 >> DENSITY_FRACTION_BITS;
+    }
+
+    if (this->runningAverageCount) {
+        this->updateRunningAverage(densityQ8);
+    } else if (this->useExponentialAverage) {
+        this->updateExponentialAverage(densityQ8);
+    }
+
+    if (this->aggregator) {
+        this->aggregator->addReadingQ8(densityQ8);
+    }
+
+    if (this->adaptiveSampling) {
+        this->updateAdaptiveSampling(dustDensity);
+    }
+
+    if (!hasBaselineCandidate) {
+        readCount++;
+        if (readCount > BASELINE_CANDIDATE_MIN_READINGS) {
+            hasBaselineCandidate = true;
+        }
+    }
+
+    this->lastReading.density = dustDensity;
+    this->lastReading.sampleCount = numSamples;
+    this->lastReading.densityQ8 = densityQ8;
+    this->lastReading.voltageMicrovolts = (avgRaw * this->voltageMultiplier) >> this->voltageShift;
+    this->lastReading.avgRawQ4 = avgRaw;
+    this->lastReading.aqi = gp2yAqi(densityQ8);
+
+#if GP2Y_DIAGNOSTICS
+    this->updateDiagnostics(baselineRaw);
+#endif
+
+#if GP2Y_SNAPSHOT
+    this->publishSnapshot();
+#endif
+
+    // last, so the callbacks see the complete reading
+    if (this->thresholdMonitor) {
+        bool hasAverage = this->useExponentialAverage || this->runningAverageCount;
+        this->thresholdMonitor->addReading(dustDensity, hasAverage ? this->getRunningAverage() : GP2YThresholdMonitor::NO_VALUE);
+    }
+
+    return dustDensity;
+}
+
+/**
+ * Get the running average value of dust density using runningAverageCount number of samples
+ * Example: If you read the density with getDustDensity() each second and runningAverageCount is 60 (default)
+ * you will get a running average for 1 minute
+ * When the sensor was constructed with a time constant, the exponential moving average is returned
+ * 
+ * @return uint16_t average dust density value between 0 and 600 ug/m3
+ * 
+ */
+uint16_t GP2YDustSensor::getRunningAverage()
+{
+    if (this->useExponentialAverage) {
+        // Q8, round to nearest
+        return (this->exponentialAverage + 128) >> 8;
+    }
+
+    if (!this->runningAverageCount) {
+        return -1;
+        //throw std::runtime_error("Running average was disabled from constructor. Use runningAverageCount to specify the size.");
+    }
+
+    if (this->runningAverageSamples == 0) {
+        return 0;
+    }
+
+    // sum (of Q4 values) and sample count are maintained by updateRunningAverage(), round to nearest
+    uint32_t divisor = (uint32_t)this->runningAverageSamples << RUNNING_AVERAGE_FRACTION_BITS;
+
+    return (this->runningAverageSum + divisor / 2) / divisor;
+} 
+
+/**
+ * Set the ADC resolution used by analogRead(). Default is 10 bits (0 - 1023)
+ * Example: 12 on ESP32 and SAMD after analogReadResolution(12)
+ *
+ * @param uint8_t bits between 8 and 16
+ */
+void GP2YDustSensor::setAdcResolution(uint8_t bits)
+{
+    if (bits < 8 || bits > 16) {
+        return;
+    }
+
+    this->adcResolution = bits;
+    this->maxAdc = ((uint32_t)1 << bits) - 1;
+    this->updateConversion();
+}
+
+uint8_t GP2YDustSensor::getAdcResolution()
+{
+    return this->adcResolution;
+}
+
+/**
+ * Set the voltage read by the ADC at full scale. Default is 5V
+ * Example: 3.3 on ESP32 with 11dB attenuation, 1.0 for the ESP8266 A0 pin
+ *
+ * @param float referenceVoltage in volts
+ */
+void GP2YDustSensor::setAdcReferenceVoltage(float referenceVoltage)
+{
+    this->adcReferenceVoltage = referenceVoltage;
+    this->updateConversion();
+}
+
+/**
+ * Set the ratio of the voltage divider between the sensor Vo output and the analog pin,
+ * so the pin voltage can be scaled back to the sensor output. Default is 1 (no divider)
+ * Example: 2 for two equal resistors, (R1 + R2) / R2 in general
+ *
+ * @param float ratio sensor voltage / pin voltage
+ */
+void GP2YDustSensor::setVoltageDividerRatio(float ratio)
+{
+    this->voltageDividerRatio = ratio;
+    this->updateConversion();
+}
+
+/**
+ * Read the sensor output through a custom ADC source (external converter, DMA driver, test double)
+ * instead of analogRead(). Use NULL to go back to analogRead()
+ * Call it before begin(), so the source is initialized
+ *
+ * @param GP2YAdcSource *adcSource owned by the caller
+ */
+void GP2YDustSensor::setAdcSource(GP2YAdcSource *adcSource)
+{
+    this->adcSource = adcSource;
+}
+
+/**
+ * Take several ADC conversions inside each LED pulse and reduce them to one sample,
+ * so fewer LED cycles are needed for the same noise level.
+ * The sensor output is flat only for a short time around the 280us sample point, so use it only
+ * with a fast converter (see GP2YAdcSource::readBurst()). analogRead() takes ~100us on AVR
+ * and ESP32 and would stretch the LED pulse well beyond the 320us of the datasheet.
+ *
+ * @param uint8_t burstSamples conversions per pulse, 1 disables the burst mode, max GP2Y_MAX_BURST_SAMPLES
+ * @param GP2YReducer reducer any reducer (see setSampleReducer()), GP2Y_REDUCE_TRIMMED_MEAN and GP2Y_REDUCE_HAMPEL
+ * only reject conversions from 4 per pulse. They run inside the pulse, the mean is the cheapest
+ */
+void GP2YDustSensor::setBurstMode(uint8_t burstSamples, GP2YReducer reducer)
+{
+    if (burstSamples < 1) {
+        burstSamples = 1;
+    } else if (burstSamples > GP2Y_MAX_BURST_SAMPLES) {
+        burstSamples = GP2Y_MAX_BURST_SAMPLES;
+    }
+
+    this->burstSamples = burstSamples;
+    this->burstReducer = reducer;
+}
+
+/**
+ * Select how getDustDensity() combines the samples. The robust reducers reject spikes
+ * (ADC glitches, insects passing the optical path), so fewer samples are needed for stable readings
+ * - GP2Y_REDUCE_MEAN: plain average (default)
+ * - GP2Y_REDUCE_MEDIAN: median
+ * - GP2Y_REDUCE_TRIMMED_MEAN: average without the lowest and highest 25% of the samples
+ * - GP2Y_REDUCE_HAMPEL: average, replacing outliers (beyond 3 scaled MADs) with the median
+ * Samples are reduced in blocks of GP2Y_MAX_FILTER_SAMPLES (32), buffered on the stack.
+ * The non-blocking API (poll()) always uses the mean.
+ *
+ * @param GP2YReducer reducer
+ */
+void GP2YDustSensor::setSampleReducer(GP2YReducer reducer)
+{
+    this->sampleReducer = reducer;
+}
+
+/**
+ * Enable adaptive sampling: while the readings are stable the sample count is halved and the read interval
+ * is doubled every few readings, down to minSamples / up to maxInterval. As soon as a reading deviates
+ * from the recent mean (more than 3 standard deviations and more than changeThreshold) the sampling goes back
+ * to maxSamples every minInterval.
+ * Read with getAdaptiveDustDensity() and wait getAdaptiveReadInterval() ms between the readings.
+ *
+ * @param uint16_t minSamples samples per reading when stable
+ * @param uint16_t maxSamples samples per reading after a change
+ * @param uint32_t minInterval ms between readings after a change
+ * @param uint32_t maxInterval ms between readings when stable
+ * @param uint16_t changeThreshold smallest deviation from the mean seen as a change, in ug/m3
+ */
+void GP2YDustSensor::enableAdaptiveSampling(uint16_t minSamples,
+                                            uint16_t maxSamples,
+                                            uint32_t minInterval,
+                                            uint32_t maxInterval,
+                                            uint16_t changeThreshold)
+{
+    this->adaptiveMinSamples = minSamples ? minSamples : 1;
+    this->adaptiveMaxSamples = maxSamples > this->adaptiveMinSamples ? maxSamples : this->adaptiveMinSamples;
+    this->adaptiveMinInterval = minInterval;
+    this->adaptiveMaxInterval = maxInterval > minInterval ? maxInterval : minInterval;
+    this->adaptiveChangeThreshold = changeThreshold;
+    // start sampling at full rate until the signal is known to be stable
+    this->adaptiveSamples = this->adaptiveMaxSamples;
+    this->adaptiveInterval = this->adaptiveMinInterval;
+    this->hasAdaptiveStatistics = false;
+    this->stableReadings = 0;
+    this->adaptiveSampling = true;
+}
+
+void GP2YDustSensor::disableAdaptiveSampling()
+{
+    this->adaptiveSampling = false;
+}
+
+/**
+ * Get average dust density using the adaptive sample count
+ *
+ * @return uint16_t dust density between 0 and 600 ug/m3
+ * @see GP2YDustSensor::enableAdaptiveSampling
+ */
+uint16_t GP2YDustSensor::getAdaptiveDustDensity()
+{
+    return this->getDustDensity(this->adaptiveSamples);
+}
+
+/**
+ * @return uint16_t number of samples the next adaptive reading will use
+ */
+uint16_t GP2YDustSensor::getAdaptiveSampleCount()
+{
+    return this->adaptiveSamples;
+}
+
+/**
+ * @return uint32_t ms to wait before the next adaptive reading
+ */
+uint32_t GP2YDustSensor::getAdaptiveReadInterval()
+{
+    return this->adaptiveInterval;
+}
+
+/**
+ * @return uint16_t number of bytes needed by saveState()
+ */
+uint16_t GP2YDustSensor::getStateSize()
+{
+    return sizeof(GP2YDustSensorState) + this->runningAverageCount * sizeof(int16_t);
+}
+
+/**
+ * Save the sensor state (baseline, baseline candidate tracking, running or exponential average, adaptive sampling)
+ * into a caller provided buffer, so it survives deep sleep. Store the buffer in RTC memory
+ * (RTC_DATA_ATTR on ESP32, ESP.rtcUserMemoryWrite() on ESP8266) and restore it with restoreState() after waking up.
+ * The configuration (sensitivity, calibration, ADC settings) is not saved, set it again in setup().
+ *
+ * @param uint8_t *buffer at least getStateSize() bytes
+ * @param uint16_t size of the buffer
+ * @return uint16_t number of bytes written, 0 if the buffer is too small
+ */
+uint16_t GP2YDustSensor::saveState(uint8_t *buffer, uint16_t size)
+{
+    uint16_t stateSize = this->getStateSize();
+
+    if (!buffer || size < stateSize) {
+        return 0;
+    }
+
+    GP2YDustSensorState state;
+    memset(&state, 0, sizeof(state));
+
+    state.magic = STATE_MAGIC;
+    state.version = STATE_VERSION;
+    state.type = this->type;
+    state.runningAverageCount = this->runningAverageCount;
+    state.zeroDustVoltage = this->zeroDustVoltage;
+    state.currentBaselineCandidate = this->currentBaselineCandidate;
+    state.minDustRaw = this->minDustRaw;
+    state.runningAverageSum = this->runningAverageSum;
+    state.runningAverageSamples = this->runningAverageSamples;
+    state.nextRunningAverageCounter = this->nextRunningAverageCounter;
+    state.exponentialAverage = this->exponentialAverage;
+    state.adaptiveMean = this->adaptiveMean;
+    state.adaptiveVariance = this->adaptiveVariance;
+    state.adaptiveInterval = this->adaptiveInterval;
+    state.adaptiveSamples = this->adaptiveSamples;
+    state.readCount = this->readCount;
+    state.lastDustDensity = this->lastReading.density;
+    state.stableReadings = this->stableReadings;
+    state.flags = (this->hasBaselineCandidate ? STATE_HAS_BASELINE_CANDIDATE : 0)
+        | (this->hasExponentialAverage ? STATE_HAS_EXPONENTIAL_AVERAGE : 0)
+        | (this->hasAdaptiveStatistics ? STATE_HAS_ADAPTIVE_STATISTICS : 0);
+
+    memcpy(buffer, &state, sizeof(state));
+    if (this->runningAverageCount) {
+        memcpy(buffer + sizeof(state), this->runningAverageBuffer, this->runningAverageCount * sizeof(int16_t));
+    }
+
+    // checksum of everything after the magic and the checksum itself
+    state.checksum = gp2yChecksum(buffer + 4, stateSize - 4);
+    memcpy(buffer, &state, sizeof(state));
+
+    return stateSize;
+}
+
+/**
+ * Restore a state saved by saveState(). The sensor must be constructed the same way
+ * (same type and runningAverageCount), otherwise the state is rejected and the sensor is left untouched.
+ *
+ * @param const uint8_t *buffer
+ * @param uint16_t size of the buffer
+ * @return bool false if the state is invalid (never saved, corrupted or from a different sensor setup)
+ */
+bool GP2YDustSensor::restoreState(const uint8_t *buffer, uint16_t size)
+{
+    uint16_t stateSize = this->getStateSize();
+    GP2YDustSensorState state;
+
+    if (!buffer || size < stateSize) {
+        return false;
+    }
+
+    memcpy(&state, buffer, sizeof(state));
+
+    if (state.magic != STATE_MAGIC
+        || state.version != STATE_VERSION
+        || state.type != this->type
+        || state.runningAverageCount != this->runningAverageCount
+        || state.checksum != gp2yChecksum(buffer + 4, stateSize - 4)) {
+        return false;
+    }
+
+    this->zeroDustVoltage = state.zeroDustVoltage;
+    this->currentBaselineCandidate = state.currentBaselineCandidate;
+    this->minDustRaw = state.minDustRaw;
+    this->runningAverageSum = state.runningAverageSum;
+    this->runningAverageSamples = state.runningAverageSamples;
+    this->nextRunningAverageCounter = state.nextRunningAverageCounter;
+    this->exponentialAverage = state.exponentialAverage;
+    this->adaptiveMean = state.adaptiveMean;
+    this->adaptiveVariance = state.adaptiveVariance;
+    this->adaptiveInterval = state.adaptiveInterval;
+    this->adaptiveSamples = state.adaptiveSamples;
+    this->readCount = state.readCount;
+    this->lastReading.density = state.lastDustDensity;
+    this->lastReading.aqi = gp2yAqi((uint32_t)state.lastDustDensity << DENSITY_FRACTION_BITS);
+    this->stableReadings = state.stableReadings;
+    this->hasBaselineCandidate = state.flags & STATE_HAS_BASELINE_CANDIDATE;
+    this->hasExponentialAverage = state.flags & STATE_HAS_EXPONENTIAL_AVERAGE;
+    this->hasAdaptiveStatistics = state.flags & STATE_HAS_ADAPTIVE_STATISTICS;
+
+    if (this->runningAverageCount) {
+        memcpy(this->runningAverageBuffer, buffer + sizeof(state), this->runningAverageCount * sizeof(int16_t));
+    }
+
+    this->updateConversion();
+
+    return true;
+}
+
+/**
+ * Set the current temperature and relative humidity (e.g. from a BME280) used by the compensation.
+ * The correction is precomputed here, so readings keep using integer math only.
+ * Call it whenever new values are available, the compensation is disabled until the
+ * coefficients are set with setTemperatureCoefficient() / setHumidityCoefficient().
+ *
+ * @param float temperature in Celsius
+ * @param float humidity relative humidity in %
+ */
+void GP2YDustSensor::setEnvironment(float temperature, float humidity)
+{
+    this->temperature = temperature;
+    this->humidity = humidity;
+    this->updateConversion();
+}
+
+/**
+ * Set how much the sensor output voltage changes with temperature.
+ * The voltage change from the reference temperature is removed before the density is computed.
+ *
+ * @param float voltsPerDegree output voltage change per Celsius degree, e.g. 0.003
+ * @param float referenceTemperature temperature at which the baseline was measured, in Celsius
+ */
+void GP2YDustSensor::setTemperatureCoefficient(float voltsPerDegree, float referenceTemperature)
+{
+    this->temperatureCoefficient = voltsPerDegree;
+    this->referenceTemperature = referenceTemperature;
+    this->updateConversion();
+}
+
+/**
+ * Set the hygroscopicity of the particles for the humidity correction (kappa-Kohler model).
+ * The signal above the baseline is divided by the particle growth factor at the current humidity.
+ * Typical kappa values: 0.2 - 0.4 for urban aerosols, 0 disables the correction.
+ *
+ * @param float kappa
+ */
+void GP2YDustSensor::setHumidityCoefficient(float kappa)
+{
+    this->humidityKappa = kappa;
+    this->updateConversion();
+}
+
+/**
+ * Get the running average with its fractional part, without the rounding of getRunningAverage()
+ *
+ * @return uint32_t average dust density in 1/256 ug/m3
+ */
+uint32_t GP2YDustSensor::getRunningAverageQ8()
+{
+    if (this->useExponentialAverage) {
+        return this->exponentialAverage > 0 ? this->exponentialAverage : 0;
+    }
+
+    if (!this->runningAverageCount || this->runningAverageSamples == 0) {
+        return 0;
+    }
+
+    // split the division so the sum can't overflow when shifted
+    uint32_t quotient = this->runningAverageSum / this->runningAverageSamples;
+    uint32_t remainder = this->runningAverageSum % this->runningAverageSamples;
+
+    const uint8_t shift = DENSITY_FRACTION_BITS - RUNNING_AVERAGE_FRACTION_BITS;
+
+    return (quotient << shift) + ((remainder << shift) + this->runningAverageSamples / 2) / this->runningAverageSamples;
+}
+
+/**
+ * Set a calibration factor to improve accuracy
+ * Calibrate against known source / precision instrument
+ * 
+ * @oaram float slope
+ */
+void GP2YDustSensor::setCalibrationFactor(float slope)
+{
+    this->calibrationFactor = slope;
+    this->updateConversion();
+}
+
+/**
+ * Precompute the integer conversion from averaged raw ADC counts to dust density.
+ * Called when the baseline, sensitivity or calibration factor change, so a reading only needs
+ * one subtract, one multiply and one shift, without float math.
+ */
+void GP2YDustSensor::updateConversion()
+{
+    float volts = this->rawToVoltage(1);
+
+    this->zeroDustRaw = this->voltageToRaw(this->zeroDustVoltage);
+    this->minZeroDustRaw = this->voltageToRaw(this->minZeroDustVoltage);
+    this->maxZeroDustRaw = this->voltageToRaw(this->maxZeroDustVoltage);
+
+    // output voltage shift with temperature
+    this->temperatureOffsetRaw = this->temperatureCoefficient * (this->temperature - this->referenceTemperature) / volts;
+
+    // Q8 ug/m3 per averaged raw unit
+    float density = volts / this->sensitivity * 100 * (1 << DENSITY_FRACTION_BITS);
+
+    // particles grow with humidity, kappa-Kohler growth factor: 1 + kappa / 1.65 / (1 / aw - 1)
+    // with aw the water activity, RH capped at 95% where the formula diverges
+    if (this->humidityKappa > 0 && this->humidity > 0) {
+        float aw = (this->humidity < 95 ? this->humidity : 95) / 100;
+        density /= 1 + this->humidityKappa / 1.65 / (1 / aw - 1);
+    }
+
+    float maxRaw = (float)(this->maxAdc + 1) * (1 << RAW_FRACTION_BITS);
+    toFixedPoint(density, maxRaw, this->densityMultiplier, this->densityShift);
+    toFixedPoint(volts * 1e6, maxRaw, this->voltageMultiplier, this->voltageShift);
+}
+
+/**
+ * @param uint32_t raw averaged raw ADC value, in 1/16 of an ADC count
+ * @return float scaled voltage
+ */
+float GP2YDustSensor::rawToVoltage(uint32_t raw)
+{
+    // we scale up the read ADC voltage to the sensor's output range
+    // so we can interpret the results based on voltage
+    float voltsPerCount = this->adcReferenceVoltage * this->voltageDividerRatio / ((uint32_t)1 << this->adcResolution);
+
+    return raw * voltsPerCount * this->calibrationFactor / (1 << RAW_FRACTION_BITS);
+}
+
+/**
+ * @param float voltage scaled voltage
+ * @return uint32_t averaged raw ADC value, in 1/16 of an ADC count
+ */
+uint32_t GP2YDustSensor::voltageToRaw(float voltage)
+{
+    if (voltage <= 0) {
+        return 0;
+    }
+
+    return voltage / this->rawToVoltage(1) + 0.5;
+}
+
+/**
+ * Attach a multi-window aggregator (1min / 15min / 1h / 24h averages)
+ * fed with every dust density reading. Use NULL to detach
+ *
+ * @param GP2YDustAggregator *aggregator owned by the caller
+ */
+void GP2YDustSensor::setAggregator(GP2YDustAggregator *aggregator)
+{
+    this->aggregator = aggregator;
+}
+
+/**
+ * Attach a threshold monitor, evaluated after every reading. Its callback fires
+ * when a threshold or rate of change trigger changes state. Use NULL to detach
+ *
+ * @param GP2YThresholdMonitor *thresholdMonitor owned by the caller
+ */
+void GP2YDustSensor::setThresholdMonitor(GP2YThresholdMonitor *thresholdMonitor)
+{
+    this->thresholdMonitor = thresholdMonitor;
+}
+
+/**
+ * Attach an automatic baseline tracker. The zero dust baseline then continuously follows the rolling minimum
+ * of the sensor output over the tracker window, moving at most maxStepVoltage per reading so there are no jumps.
+ * There is no need to call getBaselineCandidate() / setBaseline() anymore. Use NULL to detach.
+ *
+ * @param GP2YBaselineTracker *baselineTracker owned by the caller
+ * @param float maxStepVoltage maximum baseline change per reading, in volts
+ */
+void GP2YDustSensor::setBaselineTracker(GP2YBaselineTracker *baselineTracker, float maxStepVoltage)
+{
+    this->baselineTracker = baselineTracker;
+    this->baselineStepRaw = this->voltageToRaw(maxStepVoltage);
+    if (this->baselineStepRaw < 1) {
+        this->baselineStepRaw = 1;
+    }
+}
+
+/**
+ * Feed the baseline tracker and move the baseline towards the rolling minimum, rate limited
+ */
+void GP2YDustSensor::trackBaseline(uint32_t avgRaw, bool isCandidate)
+{
+    this->baselineTracker->addReading(avgRaw, isCandidate);
+
+    if (!this->baselineTracker->hasBaseline()) {
+        return;
+    }
+
+    uint32_t target = this->baselineTracker->getBaseline();
+
+    if (target == this->zeroDustRaw) {
+        return;
+    }
+
+    if (target > this->zeroDustRaw) {
+        this->zeroDustRaw += target - this->zeroDustRaw < this->baselineStepRaw ? target - this->zeroDustRaw : this->baselineStepRaw;
+    } else {
+        this->zeroDustRaw -= this->zeroDustRaw - target < this->baselineStepRaw ? this->zeroDustRaw - target : this->baselineStepRaw;
+    }
+
+    // keep getBaseline() and the state in sync
+    this->zeroDustVoltage = this->rawToVoltage(this->zeroDustRaw);
+}
+
+GP2YDustSensor::~GP2YDustSensor()
+{
+    if (this->runningAverageBuffer && this->ownsRunningAverageBuffer) {
+        delete[] this->runningAverageBuffer;
+    }
+}
+
+/**
+ * Add a value to the running average ring, keeping the sum of the valid samples up to date
+ * so getRunningAverage() does not need to scan the buffer
+ */
+void GP2YDustSensor::updateRunningAverage(uint32_t densityQ8)
+{
+    // the ring keeps 1/16 ug/m3 so the average is not quantized to whole ug/m3, rounded to nearest
+    const uint8_t shift = DENSITY_FRACTION_BITS - RUNNING_AVERAGE_FRACTION_BITS;
+    uint32_t rounded = (densityQ8 + (1 << (shift - 1))) >> shift;
+    int16_t value = rounded > 0x7FFF ? 0x7FFF : rounded;
+    int16_t evicted = this->runningAverageBuffer[this->nextRunningAverageCounter];
+
+    if (evicted == -1) {
+        this->runningAverageSamples++;
+    } else {
+        this->runningAverageSum -= evicted;
+    }
+
+    this->runningAverageSum += value;
+    this->runningAverageBuffer[this->nextRunningAverageCounter] = value;
+
+    this->nextRunningAverageCounter++;
+    if (this->nextRunningAverageCounter >= this->runningAverageCount) {
+        this->nextRunningAverageCounter = 0; 
+    }
+}
+
+/**
+ * Fold a value into the exponential moving average: average += alpha * (value - average)
+ * The average is kept in Q8 so small changes are not lost
+ */
+void GP2YDustSensor::updateExponentialAverage(uint32_t densityQ8)
+{
+    int32_t target = densityQ8;
+
+    if (!this->hasExponentialAverage) {
+        // start from the first reading instead of ramping up from 0
+        this->exponentialAverage = target;
+        this->hasExponentialAverage = true;
+        return;
+    }
+
+    this->exponentialAverage += ((int64_t)(target - this->exponentialAverage) * this->exponentialAverageAlpha) >> 16;
+}
+
+/**
+ * Track the mean and variance of the readings (exponentially weighted, 1/8 per reading)
+ * and adjust the adaptive sample count and read interval
+ */
+void GP2YDustSensor::updateAdaptiveSampling(uint16_t value)
+{
+    if (!this->hasAdaptiveStatistics) {
+        this->adaptiveMean = (int32_t)value << 8;
+        this->adaptiveVariance = 0;
+        this->hasAdaptiveStatistics = true;
+        return;
+    }
+
+    int32_t deviation = (int32_t)value - ((this->adaptiveMean + 128) >> 8);
+    uint32_t squaredDeviation = (uint32_t)(deviation * deviation);
+    uint32_t threshold = (uint32_t)this->adaptiveChangeThreshold * this->adaptiveChangeThreshold;
+    bool changed = squaredDeviation > threshold && squaredDeviation > 9 * this->adaptiveVariance;
+
+    this->adaptiveMean += (((int32_t)value << 8) - this->adaptiveMean) / 8;
+    if (squaredDeviation > this->adaptiveVariance) {
+        this->adaptiveVariance += (squaredDeviation - this->adaptiveVariance) / 8;
+    } else {
+        this->adaptiveVariance -= (this->adaptiveVariance - squaredDeviation) / 8;
+    }
+
+    if (changed) {
+        // something is happening, back to full rate
+        this->adaptiveSamples = this->adaptiveMaxSamples;
+        this->adaptiveInterval = this->adaptiveMinInterval;
+        this->stableReadings = 0;
+        return;
+    }
+
+    if (++this->stableReadings < ADAPTIVE_STABLE_READINGS) {
+        return;
+    }
+
+    this->stableReadings = 0;
+
+    this->adaptiveSamples /= 2;
+    if (this->adaptiveSamples < this->adaptiveMinSamples) {
+        this->adaptiveSamples = this->adaptiveMinSamples;
+    }
+
+    this->adaptiveInterval *= 2;
+    if (this->adaptiveInterval > this->adaptiveMaxInterval || this->adaptiveInterval == 0) {
+        this->adaptiveInterval = this->adaptiveMaxInterval;
     }
 }
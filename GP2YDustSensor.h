@@ -1,4 +1,103 @@
+#ifndef GP2Y_DUST_SENSOR_H
+#define GP2Y_DUST_SENSOR_H
+
 #include <stdint.h>
+#include <stddef.h>
+
+#include "GP2YConfig.h"
+#include "GP2YAdcSource.h"
+#include "GP2YSampleRing.h"
+#include "GP2YCalibration.h"
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+#endif
+
+/**
+ * Full result of a reading, produced in a single pass
+ */
+struct GP2YDustReading
+{
+    uint16_t density;           // dust density in ug/m3, as returned by getDustDensity()
+    uint16_t sampleCount;       // number of samples averaged
+    uint32_t densityQ8;         // dust density in 1/256 ug/m3
+    uint32_t voltageMicrovolts; // scaled sensor output voltage in microvolts
+    uint32_t avgRawQ4;          // averaged raw ADC value, in 1/16 of an ADC count
+    uint16_t aqi;               // US EPA PM2.5 AQI of the density, see gp2yAqi()
+};
+
+#if GP2Y_SNAPSHOT
+/**
+ * Results published after each reading, safe to read from another task or core (see GP2YDustSensor::getSnapshot())
+ */
+struct GP2YDustSnapshot
+{
+    GP2YDustReading reading;    // last reading
+    uint16_t runningAverage;    // as returned by getRunningAverage()
+    uint32_t runningAverageQ8;  // as returned by getRunningAverageQ8()
+    float baseline;             // zero dust voltage
+    float baselineCandidate;    // as returned by peekBaselineCandidate()
+    bool hasBaselineCandidate;
+    uint32_t readingCount;      // readings published so far, changes with every new reading
+};
+#endif
+
+#if GP2Y_TIMING_STATS
+/**
+ * Measured sampling timing, all times in microseconds (see GP2YDustSensor::getTimingStats())
+ */
+struct GP2YTimingStats
+{
+    uint32_t samples;            // samples measured
+    uint16_t minSampleOffset;    // from LED on to the start of the ADC read, should be 280
+    uint16_t maxSampleOffset;
+    uint16_t meanSampleOffset;
+    uint16_t minConversionTime;  // duration of the ADC read
+    uint16_t maxConversionTime;
+    uint16_t meanConversionTime;
+    uint32_t cycles;             // pulse to pulse intervals measured
+    uint16_t minCycleTime;       // should be 10000
+    uint16_t maxCycleTime;
+    uint16_t meanCycleTime;
+    uint32_t lateSamples;        // samples read too long after the LED turned on
+    uint32_t missedDeadlines;    // pulses started too late for the 10ms cycle
+    uint32_t overruns;           // samples lost because the timer engine ring was full
+};
+#endif
+
+#if GP2Y_DIAGNOSTICS
+/**
+ * Sensor health flags, combined in the status bitfield (see GP2YDustSensor::getStatus())
+ */
+enum GP2YStatus
+{
+    GP2Y_STATUS_OK = 0,
+    GP2Y_STATUS_BASELINE_OUT_OF_RANGE = 0x01, // baseline or lowest reading of the last hour outside the zero dust range of the type
+    GP2Y_STATUS_STUCK_ADC = 0x02,             // the same ADC value for 100 samples in a row
+    GP2Y_STATUS_SATURATED = 0x04,             // samples of the last reading at the ADC full scale
+    GP2Y_STATUS_VARIANCE_COLLAPSE = 0x08,     // samples within 1 ADC count for 10 readings in a row
+    GP2Y_STATUS_BASELINE_DRIFT = 0x10         // baseline moved faster than the maximum drift over the last hour
+};
+
+/**
+ * Sensor health counters (see GP2YDustSensor::getDiagnostics())
+ */
+struct GP2YDiagnostics
+{
+    uint8_t status;              // GP2YStatus bits of the last reading
+    uint32_t samples;            // samples checked
+    uint32_t saturatedSamples;   // samples at the ADC full scale
+    uint16_t identicalSamples;   // current run of identical samples
+    uint16_t sampleSpread;       // ADC counts between the lowest and the highest sample of the last reading
+    uint16_t collapsedReadings;  // readings in a row with a sample spread of at most 1 ADC count
+    float lowestVoltage;         // lowest reading of the last complete hour, 0 before the first hour
+    float baselineDriftRate;     // baseline change over the last complete hour, in volts per hour
+};
+#endif
+
+class GP2YDustAggregator;
+class GP2YBaselineTracker;
+class GP2YThresholdMonitor;
 
 enum GP2YDustSensorType
 {
@@ -6,15 +105,28 @@ enum GP2YDustSensorType
     GP2Y1014AU0F
 };
 
+static_assert(sizeof(GP2Y_SENSOR_CHARACTERISTICS) / sizeof(GP2YSensorCharacteristics) == GP2Y1014AU0F + 1,
+    "GP2Y_SENSOR_CHARACTERISTICS needs one entry per GP2YDustSensorType");
+
+enum GP2YReducer
+{
+    GP2Y_REDUCE_MEAN,
+    GP2Y_REDUCE_MEDIAN,
+    GP2Y_REDUCE_TRIMMED_MEAN,
+    GP2Y_REDUCE_HAMPEL
+};
+
 class GP2YDustSensor
 {
     private:
         GP2YDustSensorType type;
         uint32_t maxAdc;
+        uint8_t adcResolution;
+        float adcReferenceVoltage;
+        float voltageDividerRatio;
         uint8_t ledOutputPin;
         uint8_t analogReadPin;
         float zeroDustVoltage;
-        float minDustVoltage;
         float minZeroDustVoltage;
         float maxZeroDustVoltage;
         float typZeroDustVoltage;
@@ -23,26 +135,246 @@ class GP2YDustSensor
         uint16_t readCount = 0;
         float calibrationFactor;
         float sensitivity;
+        // fixed point conversion, precomputed by updateConversion()
+        static const uint8_t RAW_FRACTION_BITS = 4;
+        static const uint8_t DENSITY_FRACTION_BITS = 8;
+        // running average ring values, in 1/16 ug/m3 so they fit the int16_t buffer
+        static const uint8_t RUNNING_AVERAGE_FRACTION_BITS = 4;
+        uint32_t zeroDustRaw;
+        uint32_t minDustRaw;
+        uint32_t minZeroDustRaw;
+        uint32_t maxZeroDustRaw;
+        uint32_t densityMultiplier;
+        uint8_t densityShift;
+        uint32_t voltageMultiplier;
+        uint8_t voltageShift;
+        // temperature / humidity compensation
+        float temperature;
+        float referenceTemperature;
+        float temperatureCoefficient;
+        float humidity;
+        float humidityKappa;
+        int32_t temperatureOffsetRaw;
         int16_t *runningAverageBuffer;
+        bool ownsRunningAverageBuffer;
         int runningAverageCount;
         int nextRunningAverageCounter;
         int runningAverageCounter;
+        uint32_t runningAverageSum;
+        uint16_t runningAverageSamples;
+        // exponential moving average, replaces the running average buffer when enabled
+        bool useExponentialAverage;
+        bool hasExponentialAverage;
+        uint32_t exponentialAverageAlpha;
+        int32_t exponentialAverage;
+        // adaptive sampling
+        static const uint8_t ADAPTIVE_STABLE_READINGS = 4;
+        bool adaptiveSampling;
+        bool hasAdaptiveStatistics;
+        uint16_t adaptiveMinSamples;
+        uint16_t adaptiveMaxSamples;
+        uint16_t adaptiveSamples;
+        uint32_t adaptiveMinInterval;
+        uint32_t adaptiveMaxInterval;
+        uint32_t adaptiveInterval;
+        uint16_t adaptiveChangeThreshold;
+        int32_t adaptiveMean;
+        uint32_t adaptiveVariance;
+        uint8_t stableReadings;
+        GP2YBaselineTracker *baselineTracker;
+        uint32_t baselineStepRaw;
         const uint8_t BASELINE_CANDIDATE_MIN_READINGS = 10;
 
+        // Sharp timing: sample 280us after the LED turns on, one pulse every 10ms
+        static const uint16_t SAMPLE_DELAY_US = 280;
+        static const uint16_t SAMPLE_CYCLE_US = 10000;
+
+        enum MeasurementState
+        {
+            MEASUREMENT_IDLE,
+            MEASUREMENT_CYCLE_WAIT,
+            MEASUREMENT_LED_ON,
+            MEASUREMENT_READY
+        };
+
+        MeasurementState measurementState;
+        uint32_t measurementTotal;
+        uint16_t measurementSampleCount;
+        uint16_t measurementSamplesTaken;
+        uint32_t pulseStartTime;
+        GP2YDustReading lastReading;
+        GP2YSampleRing *sampleRing;
+        volatile bool timerLedOn;
+        uint16_t lastRingOverruns;
+        GP2YDustAggregator *aggregator;
+        GP2YThresholdMonitor *thresholdMonitor;
+        const GP2YSensorCharacteristics *characteristics;
+        bool highDensityCorrection;
+        GP2YAdcSource *adcSource;
+        // set by GP2YTimerEngine on ESP8266, reads the source without a virtual call
+        GP2YIsrReadFunction isrRead;
+        uint8_t burstSamples;
+        GP2YReducer burstReducer;
+        GP2YReducer sampleReducer;
+#if defined(ESP32)
+        // see GP2Y_ENTER_CRITICAL()
+        portMUX_TYPE statisticsLock;
+#endif
+#if GP2Y_SNAPSHOT
+        volatile uint32_t snapshotSequence;
+        GP2YDustSnapshot snapshot;
+        uint32_t snapshotCandidateRaw;
+#endif
+#if GP2Y_TIMING_STATS
+        static const uint16_t TIMING_TOLERANCE_US = 100;
+
+        GP2YTimingStats timingStats;
+        uint64_t sampleOffsetSum;
+        uint64_t conversionTimeSum;
+        uint64_t cycleTimeSum;
+        uint32_t lastPulseTime;
+        bool hasLastPulse;
+        uint32_t timerLedOnTime;
+#endif
+#if GP2Y_DIAGNOSTICS
+        static const uint16_t STUCK_SAMPLES = 100;
+        static const uint8_t COLLAPSE_READINGS = 10;
+        static const uint32_t DIAGNOSTICS_WINDOW_MS = 3600000;
+
+        uint8_t status;
+        bool skipSampleChecks;
+        uint32_t diagnosticSamples;
+        uint32_t saturatedSamples;
+        uint16_t readingSaturatedSamples;
+        uint16_t lastSample;
+        uint16_t identicalSamples;
+        uint16_t readingMinSample;
+        uint16_t readingMaxSample;
+        uint16_t sampleSpread;
+        uint16_t collapsedReadings;
+        // hourly window for the lowest reading and the drift rate
+        uint32_t windowStart;
+        float windowStartBaseline;
+        uint32_t windowMinRaw;
+        float lowestVoltage;
+        float baselineDriftRate;
+        float maxBaselineDrift;
+#endif
+
+        friend class GP2YTimerEngine;
+        friend class GP2YDustSensorGroup;
+        friend class GP2YSamplingTask;
+
+        void init(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin);
+        void initRunningAverage(int16_t *buffer, uint16_t count);
+        void updateConversion();
+        float rawToVoltage(uint32_t raw);
+        uint32_t voltageToRaw(float voltage);
+#if GP2Y_SNAPSHOT
+        void publishSnapshot();
+#endif
+#if GP2Y_TIMING_STATS
+        void recordTiming(uint32_t ledOnTime, uint32_t readStartTime, uint32_t readEndTime);
+#endif
+#if GP2Y_DIAGNOSTICS
+        void checkSample(uint16_t sample);
+        void updateDiagnostics(uint32_t avgRaw);
+#endif
+
     protected:
+        uint16_t readAdc();
         uint16_t readDustRawOnce();
-        void updateRunningAverage(uint16_t dustDensity);
+        uint16_t processSamples(uint32_t total, uint16_t numSamples);
+        void flushStaleSamples();
+        uint32_t drainSampleRing(uint16_t numSamples);
+        uint32_t readReducedSamples(uint16_t numSamples);
+        uint16_t takeSample();
+        uint16_t processRawAverage(uint32_t avgRaw, uint16_t numSamples);
+        uint32_t onTimerTick();
+        void updateRunningAverage(uint32_t densityQ8);
+        void updateExponentialAverage(uint32_t densityQ8);
+        void updateAdaptiveSampling(uint16_t dustDensity);
+        void trackBaseline(uint32_t avgRaw, bool isCandidate);
 
     public:
         GP2YDustSensor(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin, uint16_t runningAverageCount = 60);
+        GP2YDustSensor(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin, int16_t *runningAverageBuffer, uint16_t runningAverageCount);
+        GP2YDustSensor(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin, float timeConstant, float readInterval);
         ~GP2YDustSensor();
         void begin();
         uint16_t getDustDensity(uint16_t numSamples = 20);
+        uint16_t getDustDensityUntil(float maxError, uint16_t maxSamples = 1000, uint16_t minSamples = 20);
+        uint16_t captureRawSamples(uint16_t *samples, uint16_t count, uint32_t *timestamps = NULL);
+        void startMeasurement(uint16_t numSamples = 20);
+        bool poll();
+        bool isReady();
+        uint16_t getLastDensity();
+        GP2YDustReading getDustReading(uint16_t numSamples = 20);
+        GP2YDustReading getLastReading();
+#if GP2Y_SNAPSHOT
+        GP2YDustSnapshot getSnapshot();
+#endif
+#if GP2Y_TIMING_STATS
+        GP2YTimingStats getTimingStats();
+        void resetTimingStats();
+#endif
+#if GP2Y_DIAGNOSTICS
+        uint8_t getStatus();
+        GP2YDiagnostics getDiagnostics();
+        void resetDiagnostics();
+        void setMaxBaselineDrift(float voltsPerHour);
+#endif
         uint16_t getRunningAverage();
+        uint32_t getRunningAverageQ8();
         float getBaseline();
         void setBaseline(float zeroDustVoltage);
         float getBaselineCandidate();
+        float peekBaselineCandidate();
         void setSensitivity(float sensitivity);
         float getSensitivity();
         void setCalibrationFactor(float slope);
+        void setHighDensityCorrection(bool enabled);
+        uint16_t getAqi();
+        void setEnvironment(float temperature, float humidity);
+        void setTemperatureCoefficient(float voltsPerDegree, float referenceTemperature = 25);
+        void setHumidityCoefficient(float kappa);
+        void setAdcResolution(uint8_t bits);
+        uint8_t getAdcResolution();
+        void setAdcReferenceVoltage(float referenceVoltage);
+        void setVoltageDividerRatio(float ratio);
+        void setAdcSource(GP2YAdcSource *adcSource);
+        void setBurstMode(uint8_t burstSamples, GP2YReducer reducer = GP2Y_REDUCE_MEAN);
+        void setSampleReducer(GP2YReducer reducer);
+        void enableAdaptiveSampling(uint16_t minSamples, uint16_t maxSamples, uint32_t minInterval, uint32_t maxInterval, uint16_t changeThreshold = 5);
+        void disableAdaptiveSampling();
+        uint16_t getAdaptiveDustDensity();
+        uint16_t getAdaptiveSampleCount();
+        uint32_t getAdaptiveReadInterval();
+        uint16_t getStateSize();
+        uint16_t saveState(uint8_t *buffer, uint16_t size);
+        bool restoreState(const uint8_t *buffer, uint16_t size);
+        void setAggregator(GP2YDustAggregator *aggregator);
+        void setThresholdMonitor(GP2YThresholdMonitor *thresholdMonitor);
+        void setBaselineTracker(GP2YBaselineTracker *baselineTracker, float maxStepVoltage = 0.0005);
 };
+
+/**
+ * Allocation-free sensor with a compile time sized running average buffer
+ * Example: GP2YStaticDustSensor<60> dustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+ */
+template <uint16_t RUNNING_AVERAGE_COUNT>
+class GP2YStaticDustSensor : public GP2YDustSensor
+{
+    static_assert(RUNNING_AVERAGE_COUNT > 0, "use GP2YDustSensor with runningAverageCount 0 to disable the running average");
+
+    private:
+        int16_t runningAverageStorage[RUNNING_AVERAGE_COUNT];
+
+    public:
+        GP2YStaticDustSensor(GP2YDustSensorType type, uint8_t ledOutputPin, uint8_t analogReadPin)
+            : GP2YDustSensor(type, ledOutputPin, analogReadPin, runningAverageStorage, RUNNING_AVERAGE_COUNT)
+        {
+        }
+};
+
+#endif
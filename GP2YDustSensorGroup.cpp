@@ -0,0 +1,120 @@
+#include "GP2YHal.h"
+
+#include "GP2YDustSensorGroup.h"
+
+GP2YDustSensorGroup::GP2YDustSensorGroup()
+{
+    this->sensorCount = 0;
+}
+
+/**
+ * Add a sensor to the group
+ *
+ * @param GP2YDustSensor *sensor owned by the caller
+ * @return bool false if the group is full (8 sensors) or the sensor is sampled by the timer engine
+ */
+bool GP2YDustSensorGroup::add(GP2YDustSensor *sensor)
+{
+    // the timer interrupt owns the LED pin of the sensor
+    if (!sensor || sensor->sampleRing || this->sensorCount >= MAX_SENSORS) {
+        return false;
+    }
+
+    this->sensors[this->sensorCount++] = sensor;
+
+    return true;
+}
+
+uint8_t GP2YDustSensorGroup::getSensorCount()
+{
+    return this->sensorCount;
+}
+
+/**
+ * @return GP2YDustSensor* the sensor at index, NULL if out of range
+ */
+GP2YDustSensor *GP2YDustSensorGroup::getSensor(uint8_t index)
+{
+    if (index >= this->sensorCount) {
+        return NULL;
+    }
+
+    return this->sensors[index];
+}
+
+/**
+ * Initialize all the sensors
+ */
+void GP2YDustSensorGroup::begin()
+{
+    for (uint8_t i = 0; i < this->sensorCount; i++) {
+        this->sensors[i]->begin();
+    }
+}
+
+/**
+ * Read the average dust density of numSamples for every sensor
+ * With the default value of numSamples (20) the reading should take 200ms,
+ * whatever the number of sensors
+ * The samples are averaged with a plain mean whatever the sample reducer of the sensor.
+ * Sensors attached to the timer engine after add() are skipped
+ *
+ * @param uint16_t numSamples
+ */
+void GP2YDustSensorGroup::readAll(uint16_t numSamples)
+{
+    if (!numSamples) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < this->sensorCount; i++) {
+        this->totals[i] = 0;
+    }
+
+    for (uint16_t sample = 0; sample < numSamples; sample++) {
+        uint32_t cycleStart = micros();
+
+        // the sensors' active windows follow each other inside the same 10ms cycle
+        for (uint8_t i = 0; i < this->sensorCount; i++) {
+            if (!this->sensors[i]->sampleRing) {
+                this->totals[i] += this->sensors[i]->readDustRawOnce();
+            }
+        }
+
+        // Wait for remainder of the 10ms cycle
+        uint32_t elapsed = micros() - cycleStart;
+        if (elapsed < GP2YDustSensor::SAMPLE_CYCLE_US) {
+            delayMicroseconds(GP2YDustSensor::SAMPLE_CYCLE_US - elapsed);
+        }
+    }
+
+    for (uint8_t i = 0; i < this->sensorCount; i++) {
+        if (!this->sensors[i]->sampleRing) {
+            this->sensors[i]->processSamples(this->totals[i], numSamples);
+        }
+    }
+}
+
+/**
+ * @return uint16_t dust density of the sensor at index from the last readAll(), in ug/m3
+ */
+uint16_t GP2YDustSensorGroup::getDustDensity(uint8_t index)
+{
+    if (index >= this->sensorCount) {
+        return 0;
+    }
+
+    return this->sensors[index]->getLastDensity();
+}
+
+/**
+ * @return uint16_t running average of the sensor at index, in ug/m3
+ */
+uint16_t GP2YDustSensorGroup::getRunningAverage(uint8_t index)
+{
+    if (index >= this->sensorCount) {
+        return 0;
+    }
+
+    return this->sensors[index]->getRunningAverage();
+}
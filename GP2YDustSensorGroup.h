@@ -0,0 +1,36 @@
+#ifndef GP2Y_DUST_SENSOR_GROUP_H
+#define GP2Y_DUST_SENSOR_GROUP_H
+
+#include <stdint.h>
+
+#include "GP2YDustSensor.h"
+
+/**
+ * Reads several sensors at once. In each 10ms cycle the LED pulses of all the sensors are run
+ * one after the other (~380us each), so N sensors are sampled in the time a single one takes.
+ * Each sensor keeps its own results, running average and baseline candidate.
+ * The burst mode of each sensor (setBurstMode()) applies inside its pulse, but the samples of a reading
+ * are always combined with a plain mean: setSampleReducer() is ignored in a group.
+ * Sensors sampled by the timer engine (GP2YTimerEngine) can't be grouped.
+ */
+class GP2YDustSensorGroup
+{
+    private:
+        static const uint8_t MAX_SENSORS = 8;
+
+        GP2YDustSensor *sensors[MAX_SENSORS];
+        uint32_t totals[MAX_SENSORS];
+        uint8_t sensorCount;
+
+    public:
+        GP2YDustSensorGroup();
+        bool add(GP2YDustSensor *sensor);
+        uint8_t getSensorCount();
+        GP2YDustSensor *getSensor(uint8_t index);
+        void begin();
+        void readAll(uint16_t numSamples = 20);
+        uint16_t getDustDensity(uint8_t index);
+        uint16_t getRunningAverage(uint8_t index);
+};
+
+#endif
@@ -0,0 +1,415 @@
+#include <string.h>
+
+#include "GP2YFlashLog.h"
+#include "GP2YChecksum.h"
+
+// entry layout: timestamp (4), density (2), baseline (2), flags, reserved, checksum (2), little endian
+static void encodeEntry(const GP2YDustRecord &record, uint8_t *out)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        out[i] = record.timestamp >> (8 * i);
+    }
+    out[4] = record.density;
+    out[5] = record.density >> 8;
+    out[6] = record.baseline;
+    out[7] = record.baseline >> 8;
+    out[8] = record.flags;
+    out[9] = 0;
+
+    uint16_t checksum = gp2yChecksum(out, 10);
+    out[10] = checksum;
+    out[11] = checksum >> 8;
+}
+
+/**
+ * @return bool false if the checksum does not match (erased or torn entry)
+ */
+static bool decodeEntry(const uint8_t *in, GP2YDustRecord &record)
+{
+    if (gp2yChecksum(in, 10) != (in[10] | (uint16_t)in[11] << 8)) {
+        return false;
+    }
+
+    record.timestamp = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        record.timestamp |= (uint32_t)in[i] << (8 * i);
+    }
+    record.density = in[4] | (uint16_t)in[5] << 8;
+    record.baseline = in[6] | (uint16_t)in[7] << 8;
+    record.flags = in[8];
+
+    return true;
+}
+
+/**
+ * @param GP2YFlashStorage *storage owned by the caller
+ */
+GP2YFlashLog::GP2YFlashLog(GP2YFlashStorage *storage)
+{
+    this->storage = storage;
+    this->sectorCount = 0;
+    this->sectorSize = 0;
+    this->entriesPerSector = 0;
+    this->oldestSector = 0;
+    this->headSector = 0;
+    this->usedSectors = 0;
+    this->headSequence = 0;
+    this->headEntries = 0;
+    this->pendingCount = 0;
+    this->lastTimestamp = 0;
+    this->readIndex = 0;
+}
+
+/**
+ * Find the log written before the reset, the read position is set to the oldest record
+ *
+ * @return bool false if the storage is too small
+ */
+bool GP2YFlashLog::begin()
+{
+    uint32_t sequence;
+
+    this->sectorCount = this->storage->getSectorCount();
+    this->sectorSize = this->storage->getSectorSize();
+    this->usedSectors = 0;
+    this->headEntries = 0;
+    this->pendingCount = 0;
+    this->lastTimestamp = 0;
+    this->readIndex = 0;
+
+    if (this->sectorCount < 2 || this->sectorSize < SECTOR_HEADER_SIZE + ENTRY_SIZE) {
+        this->entriesPerSector = 0;
+        return false;
+    }
+
+    this->entriesPerSector = (this->sectorSize - SECTOR_HEADER_SIZE) / ENTRY_SIZE;
+
+    // the newest sector has the highest sequence number
+    for (uint16_t sector = 0; sector < this->sectorCount; sector++) {
+        if (this->readSectorSequence(sector, sequence) && (!this->usedSectors || sequence > this->headSequence)) {
+            this->headSector = sector;
+            this->headSequence = sequence;
+            this->usedSectors = 1;
+        }
+    }
+
+    if (!this->usedSectors) {
+        return true;
+    }
+
+    // walk back through the consecutive sequence numbers to the oldest sector
+    this->oldestSector = this->headSector;
+    while (this->usedSectors < this->sectorCount) {
+        uint16_t previous = (this->oldestSector + this->sectorCount - 1) % this->sectorCount;
+
+        if (!this->readSectorSequence(previous, sequence) || sequence != this->headSequence - this->usedSectors) {
+            break;
+        }
+        this->oldestSector = previous;
+        this->usedSectors++;
+    }
+
+    // the head sector is written in order, binary search the first erased entry
+    uint16_t low = 0;
+    uint16_t high = this->entriesPerSector;
+    while (low < high) {
+        uint16_t middle = (low + high) / 2;
+
+        if (this->isEntryErased(this->headSector, middle)) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    this->headEntries = low;
+
+    GP2YDustRecord record;
+    for (uint32_t index = this->getFlashCount(); index > 0; index--) {
+        if (this->readEntry(index - 1, record)) {
+            this->lastTimestamp = record.timestamp;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Add a record, it is written to the storage when GP2Y_FLASH_LOG_BATCH records are buffered
+ *
+ * @param const GP2YDustRecord &record
+ * @return bool false if the timestamp is older than the last record or the storage failed
+ */
+bool GP2YFlashLog::append(const GP2YDustRecord &record)
+{
+    if (!this->entriesPerSector || record.timestamp < this->lastTimestamp) {
+        return false;
+    }
+
+    if (this->pendingCount >= GP2Y_FLASH_LOG_BATCH && !this->flush()) {
+        return false;
+    }
+
+    encodeEntry(record, this->pending + this->pendingCount * ENTRY_SIZE);
+    this->pendingCount++;
+    this->lastTimestamp = record.timestamp;
+
+    if (this->pendingCount >= GP2Y_FLASH_LOG_BATCH) {
+        return this->flush();
+    }
+
+    return true;
+}
+
+/**
+ * Write the buffered records now, e.g. before deep sleep
+ *
+ * @return bool false if the storage failed, the records stay buffered
+ */
+bool GP2YFlashLog::flush()
+{
+    uint8_t written = 0;
+
+    while (written < this->pendingCount) {
+        if (!this->usedSectors || this->headEntries >= this->entriesPerSector) {
+            if (!this->startSector()) {
+                break;
+            }
+        }
+
+        uint16_t count = this->entriesPerSector - this->headEntries;
+        if (count > this->pendingCount - written) {
+            count = this->pendingCount - written;
+        }
+
+        uint32_t address = (uint32_t)this->headSector * this->sectorSize + SECTOR_HEADER_SIZE
+            + (uint32_t)this->headEntries * ENTRY_SIZE;
+        bool success = this->storage->write(address, this->pending + written * ENTRY_SIZE, count * ENTRY_SIZE);
+
+        // the entries may be partially programmed, never write them again
+        this->headEntries += count;
+        if (!success) {
+            break;
+        }
+        written += count;
+    }
+
+    if (written) {
+        memmove(this->pending, this->pending + written * ENTRY_SIZE, (this->pendingCount - written) * ENTRY_SIZE);
+        this->pendingCount -= written;
+    }
+
+    return this->pendingCount == 0;
+}
+
+/**
+ * Erase the whole log
+ *
+ * @return bool false if the storage failed
+ */
+bool GP2YFlashLog::clear()
+{
+    bool success = true;
+
+    for (uint16_t sector = 0; sector < this->sectorCount; sector++) {
+        success = this->storage->erase(sector) && success;
+    }
+
+    this->usedSectors = 0;
+    this->headEntries = 0;
+    this->pendingCount = 0;
+    this->lastTimestamp = 0;
+    this->readIndex = 0;
+
+    return success;
+}
+
+/**
+ * @return uint32_t number of records in the log, including the buffered ones
+ */
+uint32_t GP2YFlashLog::getCount()
+{
+    return this->getFlashCount() + this->pendingCount;
+}
+
+/**
+ * @return uint32_t number of records always kept, older ones are erased a sector at a time
+ */
+uint32_t GP2YFlashLog::getCapacity()
+{
+    return this->sectorCount ? (uint32_t)(this->sectorCount - 1) * this->entriesPerSector : 0;
+}
+
+/**
+ * Move the read position to the first record at or after the timestamp, with a binary search
+ *
+ * @param uint32_t timestamp
+ * @return bool false if there is no such record
+ */
+bool GP2YFlashLog::seek(uint32_t timestamp)
+{
+    uint32_t low = 0;
+    uint32_t high = this->getCount();
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (this->getTimestamp(middle) < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    this->readIndex = low;
+
+    return low < this->getCount();
+}
+
+/**
+ * Read the record at the read position and advance it, corrupted records are skipped
+ *
+ * @param GP2YDustRecord &record
+ * @return bool false at the end of the log
+ */
+bool GP2YFlashLog::read(GP2YDustRecord &record)
+{
+    while (this->readIndex < this->getCount()) {
+        if (this->readEntry(this->readIndex++, record)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return uint32_t number of records after the read position
+ */
+uint32_t GP2YFlashLog::getRemaining()
+{
+    uint32_t count = this->getCount();
+
+    return count > this->readIndex ? count - this->readIndex : 0;
+}
+
+bool GP2YFlashLog::readSectorSequence(uint16_t sector, uint32_t &sequence)
+{
+    uint8_t header[SECTOR_HEADER_SIZE];
+
+    if (!this->storage->read((uint32_t)sector * this->sectorSize, header, SECTOR_HEADER_SIZE)) {
+        return false;
+    }
+
+    if ((header[0] | (uint16_t)header[1] << 8) != SECTOR_MAGIC
+        || gp2yChecksum(header + 4, 4) != (header[2] | (uint16_t)header[3] << 8)
+    ) {
+        return false;
+    }
+
+    sequence = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        sequence |= (uint32_t)header[4 + i] << (8 * i);
+    }
+
+    return true;
+}
+
+bool GP2YFlashLog::isEntryErased(uint16_t sector, uint16_t slot)
+{
+    uint8_t entry[ENTRY_SIZE];
+    uint32_t address = (uint32_t)sector * this->sectorSize + SECTOR_HEADER_SIZE + (uint32_t)slot * ENTRY_SIZE;
+
+    if (!this->storage->read(address, entry, ENTRY_SIZE)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < ENTRY_SIZE; i++) {
+        if (entry[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Erase the sector after the head and make it the new head, dropping the oldest sector when full
+ */
+bool GP2YFlashLog::startSector()
+{
+    uint8_t header[SECTOR_HEADER_SIZE];
+    uint16_t sector = this->usedSectors ? (this->headSector + 1) % this->sectorCount : 0;
+    uint32_t sequence = this->usedSectors ? this->headSequence + 1 : 1;
+
+    if (this->usedSectors >= this->sectorCount) {
+        this->oldestSector = (this->oldestSector + 1) % this->sectorCount;
+        this->usedSectors--;
+        this->readIndex = this->readIndex > this->entriesPerSector ? this->readIndex - this->entriesPerSector : 0;
+    }
+
+    if (!this->storage->erase(sector)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < 4; i++) {
+        header[4 + i] = sequence >> (8 * i);
+    }
+    uint16_t checksum = gp2yChecksum(header + 4, 4);
+    header[0] = SECTOR_MAGIC & 0xFF;
+    header[1] = SECTOR_MAGIC >> 8;
+    header[2] = checksum;
+    header[3] = checksum >> 8;
+
+    if (!this->storage->write((uint32_t)sector * this->sectorSize, header, SECTOR_HEADER_SIZE)) {
+        return false;
+    }
+
+    if (!this->usedSectors) {
+        this->oldestSector = sector;
+    }
+    this->headSector = sector;
+    this->headSequence = sequence;
+    this->headEntries = 0;
+    this->usedSectors++;
+
+    return true;
+}
+
+uint32_t GP2YFlashLog::getFlashCount()
+{
+    return this->usedSectors ? (uint32_t)(this->usedSectors - 1) * this->entriesPerSector + this->headEntries : 0;
+}
+
+bool GP2YFlashLog::readEntry(uint32_t index, GP2YDustRecord &record)
+{
+    uint32_t flashCount = this->getFlashCount();
+
+    if (index >= flashCount) {
+        return decodeEntry(this->pending + (index - flashCount) * ENTRY_SIZE, record);
+    }
+
+    uint8_t entry[ENTRY_SIZE];
+    uint16_t sector = (this->oldestSector + index / this->entriesPerSector) % this->sectorCount;
+    uint32_t address = (uint32_t)sector * this->sectorSize + SECTOR_HEADER_SIZE
+        + (index % this->entriesPerSector) * ENTRY_SIZE;
+
+    return this->storage->read(address, entry, ENTRY_SIZE) && decodeEntry(entry, record);
+}
+
+/**
+ * @return uint32_t timestamp of the first valid record at or after index, 0xFFFFFFFF if none
+ */
+uint32_t GP2YFlashLog::getTimestamp(uint32_t index)
+{
+    GP2YDustRecord record;
+    uint32_t count = this->getCount();
+
+    for (; index < count; index++) {
+        if (this->readEntry(index, record)) {
+            return record.timestamp;
+        }
+    }
+
+    return 0xFFFFFFFF;
+}
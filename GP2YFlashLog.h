@@ -0,0 +1,59 @@
+#ifndef GP2Y_FLASH_LOG_H
+#define GP2Y_FLASH_LOG_H
+
+#include <stdint.h>
+
+#include "GP2YConfig.h"
+#include "GP2YFlashStorage.h"
+#include "GP2YRecordEncoder.h"
+
+/**
+ * Persistent ring log of records (e.g. minute averages) in flash.
+ * Sectors are filled in turn and the oldest one is erased when the storage is full,
+ * so every sector is erased equally often. Records are buffered in RAM and written
+ * GP2Y_FLASH_LOG_BATCH at a time. Each sector starts with a sequence number, so the log
+ * is found again after a reset, and every record is checksummed.
+ * Timestamps must not decrease, which allows seek() to binary search the log.
+ */
+class GP2YFlashLog
+{
+    private:
+        static const uint16_t SECTOR_MAGIC = 0x4C32;
+        static const uint8_t SECTOR_HEADER_SIZE = 8;
+        static const uint8_t ENTRY_SIZE = 12;
+
+        GP2YFlashStorage *storage;
+        uint16_t sectorCount;
+        uint16_t sectorSize;
+        uint16_t entriesPerSector;
+        uint16_t oldestSector;
+        uint16_t headSector;
+        uint16_t usedSectors;
+        uint32_t headSequence;
+        uint16_t headEntries;
+        uint8_t pending[GP2Y_FLASH_LOG_BATCH * ENTRY_SIZE];
+        uint8_t pendingCount;
+        uint32_t lastTimestamp;
+        uint32_t readIndex;
+
+        bool readSectorSequence(uint16_t sector, uint32_t &sequence);
+        bool isEntryErased(uint16_t sector, uint16_t slot);
+        bool startSector();
+        uint32_t getFlashCount();
+        bool readEntry(uint32_t index, GP2YDustRecord &record);
+        uint32_t getTimestamp(uint32_t index);
+
+    public:
+        GP2YFlashLog(GP2YFlashStorage *storage);
+        bool begin();
+        bool append(const GP2YDustRecord &record);
+        bool flush();
+        bool clear();
+        uint32_t getCount();
+        uint32_t getCapacity();
+        bool seek(uint32_t timestamp);
+        bool read(GP2YDustRecord &record);
+        uint32_t getRemaining();
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef GP2Y_FLASH_STORAGE_H
+#define GP2Y_FLASH_STORAGE_H
+
+#include <stdint.h>
+
+/**
+ * Erasable storage used by GP2YFlashLog.
+ * Implement it on top of a raw flash partition (esp_partition, SPIFlash), an EEPROM
+ * or a preallocated LittleFS file (see examples/FlashLog).
+ * The storage is divided in sectors of equal size, addressed from 0 to getSectorCount() * getSectorSize().
+ * An erased sector must read back as 0xFF bytes.
+ */
+class GP2YFlashStorage
+{
+    public:
+        virtual ~GP2YFlashStorage() {}
+
+        /**
+         * @return uint16_t number of sectors, at least 2
+         */
+        virtual uint16_t getSectorCount() = 0;
+
+        /**
+         * @return uint16_t sector size in bytes, e.g. 4096 for NOR flash
+         */
+        virtual uint16_t getSectorSize() = 0;
+
+        /**
+         * @param uint32_t address
+         * @param uint8_t *data
+         * @param uint16_t size
+         * @return bool false on error
+         */
+        virtual bool read(uint32_t address, uint8_t *data, uint16_t size) = 0;
+
+        /**
+         * Program erased bytes. Writes never cross a sector boundary
+         *
+         * @param uint32_t address
+         * @param const uint8_t *data
+         * @param uint16_t size
+         * @return bool false on error
+         */
+        virtual bool write(uint32_t address, const uint8_t *data, uint16_t size) = 0;
+
+        /**
+         * @param uint16_t sector
+         * @return bool false on error
+         */
+        virtual bool erase(uint16_t sector) = 0;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef GP2Y_HAL_H
+#define GP2Y_HAL_H
+
+/**
+ * Hardware access used by the library: pinMode(), digitalWrite(), analogRead(),
+ * delayMicroseconds(), micros(), yield(), interrupts() / noInterrupts().
+ * Define GP2Y_HAL_SIMULATED to build the library on a host computer against GP2YHalSim
+ * (virtual clock, simulated pins and ADC) instead of the Arduino core
+ */
+#ifdef GP2Y_HAL_SIMULATED
+    #include "GP2YHalSim.h"
+#else
+    #include <Arduino.h>
+#endif
+
+#endif
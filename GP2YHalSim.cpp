@@ -0,0 +1,149 @@
+#ifdef GP2Y_HAL_SIMULATED
+
+#include <string.h>
+
+#include "GP2YHalSim.h"
+
+uint64_t GP2YHalSim::time = 0;
+uint32_t GP2YHalSim::analogReadTime = 100;
+GP2YAdcSource *GP2YHalSim::analogSource = NULL;
+uint32_t GP2YHalSim::analogReads = 0;
+uint32_t GP2YHalSim::digitalWrites = 0;
+uint8_t GP2YHalSim::pinStates[GP2YHalSim::MAX_PINS];
+uint64_t GP2YHalSim::pinWriteTimes[GP2YHalSim::MAX_PINS];
+
+/**
+ * Restart the clock at 0, clear the counters and set every pin LOW
+ */
+void GP2YHalSim::reset()
+{
+    time = 0;
+    analogReads = 0;
+    digitalWrites = 0;
+    memset(pinStates, LOW, sizeof(pinStates));
+    memset(pinWriteTimes, 0, sizeof(pinWriteTimes));
+}
+
+/**
+ * @return uint64_t simulated time in microseconds, never wraps
+ */
+uint64_t GP2YHalSim::getTime()
+{
+    return time;
+}
+
+/**
+ * @param uint32_t us
+ */
+void GP2YHalSim::advance(uint32_t us)
+{
+    time += us;
+}
+
+/**
+ * @param GP2YAdcSource *source returns the values of analogRead(), NULL reads 0
+ */
+void GP2YHalSim::setAnalogSource(GP2YAdcSource *source)
+{
+    analogSource = source;
+}
+
+/**
+ * @param uint32_t us duration of analogRead(), 100us by default like AVR and ESP32
+ */
+void GP2YHalSim::setAnalogReadTime(uint32_t us)
+{
+    analogReadTime = us;
+}
+
+uint32_t GP2YHalSim::getAnalogReads()
+{
+    return analogReads;
+}
+
+uint32_t GP2YHalSim::getDigitalWrites()
+{
+    return digitalWrites;
+}
+
+/**
+ * Useful to check the timing of the sensor LED pulse from a GP2YAdcSource
+ *
+ * @param uint8_t pin
+ * @return uint32_t microseconds since the last digitalWrite() to the pin
+ */
+uint32_t GP2YHalSim::getTimeSinceWrite(uint8_t pin)
+{
+    return pin < MAX_PINS ? time - pinWriteTimes[pin] : 0;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    GP2YHalSim::digitalWrites++;
+
+    if (pin < GP2YHalSim::MAX_PINS) {
+        GP2YHalSim::pinStates[pin] = value;
+        GP2YHalSim::pinWriteTimes[pin] = GP2YHalSim::time;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < GP2YHalSim::MAX_PINS ? GP2YHalSim::pinStates[pin] : LOW;
+}
+
+/**
+ * The value is sampled when the conversion starts, then the conversion time elapses
+ */
+int analogRead(uint8_t pin)
+{
+    int value = GP2YHalSim::analogSource ? GP2YHalSim::analogSource->read(pin) : 0;
+
+    GP2YHalSim::analogReads++;
+    GP2YHalSim::time += GP2YHalSim::analogReadTime;
+
+    return value;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    GP2YHalSim::advance(us);
+}
+
+void delay(unsigned long ms)
+{
+    GP2YHalSim::advance(ms * 1000);
+}
+
+uint32_t micros()
+{
+    GP2YHalSim::advance(1);
+
+    return GP2YHalSim::getTime();
+}
+
+uint32_t millis()
+{
+    return GP2YHalSim::getTime() / 1000;
+}
+
+void yield()
+{
+    GP2YHalSim::advance(1);
+}
+
+void noInterrupts()
+{
+}
+
+void interrupts()
+{
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef GP2Y_HAL_SIM_H
+#define GP2Y_HAL_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "GP2YAdcSource.h"
+
+/**
+ * Simulated Arduino functions for host builds (GP2Y_HAL_SIMULATED, see GP2YHal.h).
+ * Time is virtual: delays advance the clock instantly, so millions of sampling cycles
+ * run per second. micros() and yield() advance it by 1us so busy-wait loops make progress.
+ * Like on the 32 bit Arduino cores micros() wraps after about 71 minutes.
+ */
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void delayMicroseconds(unsigned int us);
+void delay(unsigned long ms);
+uint32_t micros();
+uint32_t millis();
+void yield();
+void noInterrupts();
+void interrupts();
+
+/**
+ * Control of the simulated hardware
+ */
+class GP2YHalSim
+{
+    private:
+        static const uint8_t MAX_PINS = 64;
+
+        static uint64_t time;
+        static uint32_t analogReadTime;
+        static GP2YAdcSource *analogSource;
+        static uint32_t analogReads;
+        static uint32_t digitalWrites;
+        static uint8_t pinStates[MAX_PINS];
+        static uint64_t pinWriteTimes[MAX_PINS];
+
+        friend void digitalWrite(uint8_t pin, uint8_t value);
+        friend int digitalRead(uint8_t pin);
+        friend int analogRead(uint8_t pin);
+
+    public:
+        static void reset();
+        static uint64_t getTime();
+        static void advance(uint32_t us);
+        static void setAnalogSource(GP2YAdcSource *source);
+        static void setAnalogReadTime(uint32_t us);
+        static uint32_t getAnalogReads();
+        static uint32_t getDigitalWrites();
+        static uint32_t getTimeSinceWrite(uint8_t pin);
+};
+
+#endif
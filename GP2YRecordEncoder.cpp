@@ -0,0 +1,213 @@
+#include <string.h>
+
+#include "GP2YRecordEncoder.h"
+
+// longest encoded record: 5 byte timestamp varint, 2 x 3 byte zigzag varints, flags
+static const uint8_t MAX_RECORD_SIZE = 12;
+
+static uint8_t writeVarint(uint8_t *out, uint32_t value)
+{
+    uint8_t length = 0;
+
+    while (value >= 0x80) {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+
+    return length;
+}
+
+/**
+ * @return bool false if the buffer ended before the varint
+ */
+static bool readVarint(const uint8_t *buffer, uint16_t length, uint16_t &position, uint32_t &value)
+{
+    value = 0;
+
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (position >= length) {
+            return false;
+        }
+
+        uint8_t byte = buffer[position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @param uint8_t *buffer receives the frame, owned by the caller
+ * @param uint16_t size of the buffer, e.g. the maximum LoRa payload for the data rate
+ */
+GP2YRecordEncoder::GP2YRecordEncoder(uint8_t *buffer, uint16_t size)
+{
+    this->buffer = buffer;
+    this->size = size;
+    this->reset();
+}
+
+/**
+ * Start a new frame
+ */
+void GP2YRecordEncoder::reset()
+{
+    this->length = 0;
+    this->recordCount = 0;
+    memset(&this->previous, 0, sizeof(this->previous));
+}
+
+/**
+ * Append a record to the frame
+ *
+ * @param const GP2YDustRecord &record
+ * @return bool false if the record does not fit (the frame is complete, send it and reset()),
+ * or its timestamp is older than the previous one
+ */
+bool GP2YRecordEncoder::add(const GP2YDustRecord &record)
+{
+    uint8_t encoded[MAX_RECORD_SIZE];
+    uint8_t encodedLength = 0;
+
+    if (this->size < HEADER_SIZE || this->recordCount == 0xFF) {
+        return false;
+    }
+
+    if (this->recordCount == 0) {
+        this->previous.timestamp = record.timestamp;
+    } else if (record.timestamp < this->previous.timestamp) {
+        return false;
+    }
+
+    bool flagsChanged = record.flags != this->previous.flags;
+
+    encodedLength += writeVarint(encoded, ((record.timestamp - this->previous.timestamp) << 1) | flagsChanged);
+    encodedLength += writeVarint(encoded + encodedLength, zigzag((int32_t)record.density - this->previous.density));
+    encodedLength += writeVarint(encoded + encodedLength, zigzag((int32_t)record.baseline - this->previous.baseline));
+    if (flagsChanged) {
+        encoded[encodedLength++] = record.flags;
+    }
+
+    uint16_t start = this->recordCount ? this->length : HEADER_SIZE;
+    if (start + encodedLength > this->size) {
+        return false;
+    }
+
+    if (this->recordCount == 0) {
+        this->buffer[0] = FORMAT_VERSION;
+        for (uint8_t i = 0; i < 4; i++) {
+            this->buffer[2 + i] = record.timestamp >> (8 * i);
+        }
+    }
+
+    memcpy(this->buffer + start, encoded, encodedLength);
+    this->length = start + encodedLength;
+    this->recordCount++;
+    this->buffer[1] = this->recordCount;
+    this->previous = record;
+
+    return true;
+}
+
+/**
+ * @return uint16_t number of bytes of the frame written so far
+ */
+uint16_t GP2YRecordEncoder::getLength()
+{
+    return this->length;
+}
+
+uint8_t GP2YRecordEncoder::getRecordCount()
+{
+    return this->recordCount;
+}
+
+/**
+ * @param const uint8_t *buffer frame written by GP2YRecordEncoder
+ * @param uint16_t length of the frame
+ */
+GP2YRecordDecoder::GP2YRecordDecoder(const uint8_t *buffer, uint16_t length)
+{
+    this->buffer = buffer;
+    this->length = length;
+    this->position = GP2YRecordEncoder::HEADER_SIZE;
+    this->recordsLeft = 0;
+    memset(&this->previous, 0, sizeof(this->previous));
+
+    if (this->isValid()) {
+        this->recordsLeft = buffer[1];
+        for (uint8_t i = 0; i < 4; i++) {
+            this->previous.timestamp |= (uint32_t)buffer[2 + i] << (8 * i);
+        }
+    }
+}
+
+/**
+ * @return bool true if the frame has a known version and a complete header
+ */
+bool GP2YRecordDecoder::isValid()
+{
+    return this->length >= GP2YRecordEncoder::HEADER_SIZE && this->buffer[0] == GP2YRecordEncoder::FORMAT_VERSION;
+}
+
+/**
+ * @return uint8_t number of records in the frame
+ */
+uint8_t GP2YRecordDecoder::getRecordCount()
+{
+    return this->isValid() ? this->buffer[1] : 0;
+}
+
+/**
+ * Read the next record
+ *
+ * @param GP2YDustRecord &record
+ * @return bool false when all records were read or the frame is truncated
+ */
+bool GP2YRecordDecoder::next(GP2YDustRecord &record)
+{
+    uint32_t timestampField, densityDelta, baselineDelta;
+
+    if (this->recordsLeft == 0) {
+        return false;
+    }
+
+    if (!readVarint(this->buffer, this->length, this->position, timestampField)
+        || !readVarint(this->buffer, this->length, this->position, densityDelta)
+        || !readVarint(this->buffer, this->length, this->position, baselineDelta)
+    ) {
+        this->recordsLeft = 0;
+        return false;
+    }
+
+    if (timestampField & 1) {
+        if (this->position >= this->length) {
+            this->recordsLeft = 0;
+            return false;
+        }
+        this->previous.flags = this->buffer[this->position++];
+    }
+
+    this->previous.timestamp += timestampField >> 1;
+    this->previous.density += unzigzag(densityDelta);
+    this->previous.baseline += unzigzag(baselineDelta);
+    this->recordsLeft--;
+
+    record = this->previous;
+
+    return true;
+}
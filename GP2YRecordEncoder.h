@@ -0,0 +1,67 @@
+#ifndef GP2Y_RECORD_ENCODER_H
+#define GP2Y_RECORD_ENCODER_H
+
+#include <stdint.h>
+
+/**
+ * One telemetry record, e.g. a minute average
+ */
+struct GP2YDustRecord
+{
+    uint32_t timestamp; // seconds, any epoch, must not decrease within a frame
+    uint16_t density;   // ug/m3, or any unit chosen by the application (e.g. 0.1 ug/m3)
+    uint16_t baseline;  // zero dust voltage in mV
+    uint8_t flags;      // application / sensor status flags
+};
+
+/**
+ * Packed binary frame of records for low bandwidth uplinks (LoRa)
+ *
+ * Header: version (1 byte), record count (1 byte), timestamp of the first record (4 bytes, little endian)
+ * Each record, as deltas from the previous one (the first one from 0):
+ * - varint: timestamp delta << 1 | flags changed bit
+ * - zigzag varint: density delta
+ * - zigzag varint: baseline delta
+ * - flags (1 byte), only when the flags changed
+ * A minute average with stable baseline and flags usually takes 3 bytes.
+ */
+class GP2YRecordEncoder
+{
+    private:
+        uint8_t *buffer;
+        uint16_t size;
+        uint16_t length;
+        uint8_t recordCount;
+        GP2YDustRecord previous;
+
+    public:
+        static const uint8_t FORMAT_VERSION = 1;
+        static const uint8_t HEADER_SIZE = 6;
+
+        GP2YRecordEncoder(uint8_t *buffer, uint16_t size);
+        void reset();
+        bool add(const GP2YDustRecord &record);
+        uint16_t getLength();
+        uint8_t getRecordCount();
+};
+
+/**
+ * Reads back the records of a frame written by GP2YRecordEncoder
+ */
+class GP2YRecordDecoder
+{
+    private:
+        const uint8_t *buffer;
+        uint16_t length;
+        uint16_t position;
+        uint8_t recordsLeft;
+        GP2YDustRecord previous;
+
+    public:
+        GP2YRecordDecoder(const uint8_t *buffer, uint16_t length);
+        bool isValid();
+        uint8_t getRecordCount();
+        bool next(GP2YDustRecord &record);
+};
+
+#endif
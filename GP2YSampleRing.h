@@ -0,0 +1,133 @@
+#ifndef GP2Y_SAMPLE_RING_H
+#define GP2Y_SAMPLE_RING_H
+
+#include <stdint.h>
+
+#include "GP2YConfig.h"
+
+#if (GP2Y_SAMPLE_RING_SIZE & (GP2Y_SAMPLE_RING_SIZE - 1)) || GP2Y_SAMPLE_RING_SIZE > 128
+    #error "GP2Y_SAMPLE_RING_SIZE must be a power of two, max 128"
+#endif
+
+/**
+ * Lock-free single-producer / single-consumer ring buffer of raw ADC samples.
+ * The producer (timer interrupt) only writes head, the consumer (foreground) only writes tail,
+ * so no locking is needed. The 8 bit indices are read and written atomically on every target.
+ * The methods are defined inline because they are called from interrupt context.
+ */
+class GP2YSampleRing
+{
+    private:
+        uint16_t samples[GP2Y_SAMPLE_RING_SIZE];
+        volatile uint8_t head;
+        volatile uint8_t tail;
+        volatile uint16_t overruns;
+
+    public:
+        static const uint8_t MASK = GP2Y_SAMPLE_RING_SIZE - 1;
+
+        GP2YSampleRing()
+        {
+            this->head = 0;
+            this->tail = 0;
+            this->overruns = 0;
+        }
+
+        /**
+         * Producer side. Drops the sample and counts an overrun when the ring is full
+         *
+         * @return bool false if the ring was full
+         */
+        GP2Y_ISR_ATTR bool push(uint16_t sample)
+        {
+            uint8_t currentHead = this->head;
+
+            if ((uint8_t)(currentHead - this->tail) >= GP2Y_SAMPLE_RING_SIZE) {
+                this->overruns++;
+                return false;
+            }
+
+            this->samples[currentHead & MASK] = sample;
+            // the sample must be visible before the new head
+            GP2Y_MEMORY_BARRIER();
+            this->head = currentHead + 1;
+
+            return true;
+        }
+
+        /**
+         * Consumer side
+         *
+         * @return bool false if the ring was empty
+         */
+        bool pop(uint16_t &sample)
+        {
+            uint8_t currentTail = this->tail;
+
+            if (currentTail == this->head) {
+                return false;
+            }
+
+            GP2Y_MEMORY_BARRIER();
+            sample = this->samples[currentTail & MASK];
+            // the slot must be read before it is handed back to the producer
+            GP2Y_MEMORY_BARRIER();
+            this->tail = currentTail + 1;
+
+            return true;
+        }
+
+        /**
+         * @return uint8_t number of samples ready to be consumed
+         */
+        uint8_t available()
+        {
+            return this->head - this->tail;
+        }
+
+        /**
+         * Consumer side. Zero-copy access to the oldest buffered samples.
+         * The samples stay valid until they are released with consume()
+         *
+         * @param const uint16_t *&samples set to the oldest sample
+         * @return uint8_t number of contiguous samples at samples, call again after consume() for the ones after the wrap around
+         */
+        uint8_t peek(const uint16_t *&samples)
+        {
+            uint8_t currentTail = this->tail;
+            uint8_t count = this->head - currentTail;
+            uint8_t untilEnd = GP2Y_SAMPLE_RING_SIZE - (currentTail & MASK);
+
+            GP2Y_MEMORY_BARRIER();
+            samples = &this->samples[currentTail & MASK];
+
+            return count < untilEnd ? count : untilEnd;
+        }
+
+        /**
+         * Consumer side. Release count samples returned by peek()
+         */
+        void consume(uint8_t count)
+        {
+            GP2Y_MEMORY_BARRIER();
+            this->tail = this->tail + count;
+        }
+
+        /**
+         * Consumer side. Discard all the buffered samples
+         */
+        void flush()
+        {
+            this->tail = this->head;
+        }
+
+        /**
+         * @return uint16_t number of samples dropped because the ring was full
+         */
+        uint16_t getOverruns()
+        {
+            return this->overruns;
+        }
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "GP2YHal.h"
+
+#include "GP2YSamplingTask.h"
+
+#if defined(ESP32)
+
+/**
+ * @param GP2YDustSensor *sensor owned by the caller, call its begin() first
+ */
+GP2YSamplingTask::GP2YSamplingTask(GP2YDustSensor *sensor)
+{
+    this->sensor = sensor;
+    this->task = NULL;
+    this->running = false;
+    this->numSamples = 20;
+    this->readInterval = 1000;
+    this->batchSize = 1;
+    this->batch.count = 0;
+    this->publishedBatch.count = 0;
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    this->batchLock = unlocked;
+    this->queue = NULL;
+    this->notifyTask = NULL;
+    this->callback = NULL;
+    this->callbackContext = NULL;
+    this->droppedBatches = 0;
+}
+
+GP2YSamplingTask::~GP2YSamplingTask()
+{
+    this->end();
+}
+
+/**
+ * Start the sampling task
+ *
+ * @param uint16_t numSamples - samples per reading, like getDustDensity()
+ * @param uint32_t readIntervalMs - milliseconds from the start of one reading to the next, at least numSamples * 10
+ * @param BaseType_t core - 0 or 1, the Arduino loop() runs on core 1
+ * @param UBaseType_t priority - FreeRTOS priority, higher than the tasks which may delay the pulses
+ * @param uint32_t stackSize - bytes, grow it if the callback needs more
+ * @return bool false if the task could not be created or is already running
+ */
+bool GP2YSamplingTask::begin(uint16_t numSamples, uint32_t readIntervalMs, BaseType_t core,
+    UBaseType_t priority, uint32_t stackSize)
+{
+    if (this->task) {
+        return false;
+    }
+
+    this->numSamples = numSamples ? numSamples : 1;
+    this->readInterval = readIntervalMs;
+    this->batch.count = 0;
+    this->running = true;
+
+    if (xTaskCreatePinnedToCore(&GP2YSamplingTask::run, "gp2y", stackSize, this, priority, &this->task, core) != pdPASS) {
+        this->task = NULL;
+        this->running = false;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Stop the task after the sample in progress, readings of an incomplete batch are discarded.
+ * Waits for the task to exit, except when called from the callback
+ */
+void GP2YSamplingTask::end()
+{
+    this->running = false;
+
+    if (xTaskGetCurrentTaskHandle() == this->task) {
+        return;
+    }
+
+    // the task clears its handle just before deleting itself
+    while (this->task) {
+        vTaskDelay(1);
+    }
+}
+
+bool GP2YSamplingTask::isRunning()
+{
+    return this->task != NULL;
+}
+
+/**
+ * @param uint8_t batchSize - readings per delivery, between 1 and GP2Y_TASK_MAX_BATCH
+ */
+void GP2YSamplingTask::setBatchSize(uint8_t batchSize)
+{
+    this->batchSize = batchSize < 1 ? 1 : (batchSize > GP2Y_TASK_MAX_BATCH ? GP2Y_TASK_MAX_BATCH : batchSize);
+}
+
+/**
+ * @param uint8_t length - number of batches the queue holds
+ * @return QueueHandle_t queue of GP2YDustBatch items for setQueue()
+ */
+QueueHandle_t GP2YSamplingTask::createQueue(uint8_t length)
+{
+    return xQueueCreate(length, sizeof(GP2YDustBatch));
+}
+
+/**
+ * Send every batch to a queue of GP2YDustBatch (see createQueue()). A batch is dropped
+ * if the queue is full, the sampling never waits for the consumer. Use NULL to stop
+ *
+ * @param QueueHandle_t queue
+ */
+void GP2YSamplingTask::setQueue(QueueHandle_t queue)
+{
+    this->queue = queue;
+}
+
+/**
+ * Notify a task when a batch is ready, with the number of readings as notification value.
+ * The task then reads the batch with getBatch(). Use NULL to stop
+ *
+ * @param TaskHandle_t task
+ */
+void GP2YSamplingTask::setNotifyTask(TaskHandle_t task)
+{
+    this->notifyTask = task;
+}
+
+/**
+ * Call a function with every batch. It runs in the sampling task, so it must return
+ * quickly to keep the 10ms cadence. Use NULL to stop
+ *
+ * @param Callback callback
+ * @param void *context passed to the callback
+ */
+void GP2YSamplingTask::setCallback(Callback callback, void *context)
+{
+    this->callback = callback;
+    this->callbackContext = context;
+}
+
+/**
+ * Copy of the last complete batch, from any task
+ *
+ * @param GP2YDustBatch &batch
+ * @return uint8_t number of readings, 0 before the first batch
+ */
+uint8_t GP2YSamplingTask::getBatch(GP2YDustBatch &batch)
+{
+    portENTER_CRITICAL(&this->batchLock);
+    batch = this->publishedBatch;
+    portEXIT_CRITICAL(&this->batchLock);
+
+    return batch.count;
+}
+
+/**
+ * @return uint32_t number of batches which did not fit in the queue
+ */
+uint32_t GP2YSamplingTask::getDroppedBatches()
+{
+    return this->droppedBatches;
+}
+
+void GP2YSamplingTask::run(void *parameter)
+{
+    GP2YSamplingTask *self = (GP2YSamplingTask *)parameter;
+    GP2YDustSensor *sensor = self->sensor;
+    TickType_t readingStart = xTaskGetTickCount();
+
+    while (self->running) {
+        TickType_t lastWake = xTaskGetTickCount();
+        uint32_t total = 0;
+
+        if (sensor->sampleRing) {
+            sensor->flushStaleSamples();
+        }
+
+        bool complete = true;
+
+        for (uint16_t i = 0; i < self->numSamples && complete; i++) {
+            uint16_t sample;
+
+            complete = self->takeSample(lastWake, sample);
+            total += sample;
+        }
+
+        if (!self->running) {
+            break;
+        }
+
+        if (!complete) {
+            // the timer engine stopped in the middle of the reading, start again with direct sampling
+            continue;
+        }
+
+        sensor->processSamples(total, self->numSamples);
+        self->batch.readings[self->batch.count++] = sensor->getLastReading();
+
+        if (self->batch.count >= self->batchSize) {
+            self->deliver();
+            self->batch.count = 0;
+        }
+
+        vTaskDelayUntil(&readingStart, pdMS_TO_TICKS(self->readInterval));
+    }
+
+    self->task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * One sample: from the timer engine ring, or a pulse followed by a sleep to the end of the 10ms cycle
+ *
+ * @param TickType_t &lastWake
+ * @param uint16_t &sample receives the raw sample
+ * @return bool false when the task is stopping, or the timer engine stopped while waiting for its ring
+ */
+bool GP2YSamplingTask::takeSample(TickType_t &lastWake, uint16_t &sample)
+{
+    sample = 0;
+
+    if (!this->running) {
+        return false;
+    }
+
+    if (this->sensor->sampleRing) {
+        // GP2YTimerEngine::end() detaches the ring, and without the engine no samples arrive anymore
+        GP2YSampleRing *ring;
+
+        while ((ring = this->sensor->sampleRing) && !ring->pop(sample)) {
+            if (!this->running) {
+                return false;
+            }
+            vTaskDelay(1);
+        }
+
+        return ring != NULL;
+    }
+
+    sample = this->sensor->readDustRawOnce();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(GP2YDustSensor::SAMPLE_CYCLE_US / 1000));
+
+    return true;
+}
+
+void GP2YSamplingTask::deliver()
+{
+    portENTER_CRITICAL(&this->batchLock);
+    this->publishedBatch = this->batch;
+    portEXIT_CRITICAL(&this->batchLock);
+
+    if (this->queue && xQueueSend(this->queue, &this->batch, 0) != pdTRUE) {
+        this->droppedBatches++;
+    }
+
+    if (this->notifyTask) {
+        xTaskNotify(this->notifyTask, this->batch.count, eSetValueWithOverwrite);
+    }
+
+    if (this->callback) {
+        this->callback(this->batch, this->callbackContext);
+    }
+}
+
+#endif
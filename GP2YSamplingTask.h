@@ -0,0 +1,75 @@
+#ifndef GP2Y_SAMPLING_TASK_H
+#define GP2Y_SAMPLING_TASK_H
+
+#include <stdint.h>
+
+#include "GP2YConfig.h"
+#include "GP2YDustSensor.h"
+
+#if defined(ESP32)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+/**
+ * Readings delivered together by GP2YSamplingTask
+ */
+struct GP2YDustBatch
+{
+    uint8_t count;
+    GP2YDustReading readings[GP2Y_TASK_MAX_BATCH];
+};
+
+/**
+ * FreeRTOS task taking the readings of one sensor on ESP32, pinned to a core.
+ * The 10ms pulses are timed with vTaskDelayUntil(), so the CPU is free between them,
+ * or taken from GP2YTimerEngine when it is running. Readings are collected in batches
+ * delivered through a queue of GP2YDustBatch, a task notification or a callback,
+ * so consumers wake up once per batch. Readings use the mean of the samples.
+ * Needs the 1ms FreeRTOS tick of the Arduino core.
+ */
+class GP2YSamplingTask
+{
+    public:
+        typedef void (*Callback)(const GP2YDustBatch &batch, void *context);
+
+    private:
+        GP2YDustSensor *sensor;
+        TaskHandle_t task;
+        volatile bool running;
+        uint16_t numSamples;
+        uint32_t readInterval;
+        uint8_t batchSize;
+        GP2YDustBatch batch;
+        GP2YDustBatch publishedBatch;
+        portMUX_TYPE batchLock;
+        QueueHandle_t queue;
+        TaskHandle_t notifyTask;
+        Callback callback;
+        void *callbackContext;
+        uint32_t droppedBatches;
+
+        static void run(void *parameter);
+        bool takeSample(TickType_t &lastWake, uint16_t &sample);
+        void deliver();
+
+    public:
+        GP2YSamplingTask(GP2YDustSensor *sensor);
+        ~GP2YSamplingTask();
+        bool begin(uint16_t numSamples = 20, uint32_t readIntervalMs = 1000, BaseType_t core = 1,
+            UBaseType_t priority = 2, uint32_t stackSize = 3072);
+        void end();
+        bool isRunning();
+        void setBatchSize(uint8_t batchSize);
+        static QueueHandle_t createQueue(uint8_t length);
+        void setQueue(QueueHandle_t queue);
+        void setNotifyTask(TaskHandle_t task);
+        void setCallback(Callback callback, void *context = NULL);
+        uint8_t getBatch(GP2YDustBatch &batch);
+        uint32_t getDroppedBatches();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,181 @@
+#include "GP2YHal.h"
+
+#include "GP2YSignalGenerator.h"
+
+/**
+ * Default signal: 0.6V zero dust voltage, no dust, no drift, no noise, 10 bit ADC at 5V
+ *
+ * @param uint32_t seed of the noise and spikes
+ */
+GP2YSignalGenerator::GP2YSignalGenerator(uint32_t seed)
+{
+    this->state = seed ? seed : 1;
+    this->zeroDustVoltage = 0.6;
+    this->driftPerHour = 0;
+    this->density = 0;
+    this->sensitivity = 0.5;
+    this->noise = 0;
+    this->spikeProbability = 0;
+    this->spikeVoltage = 0;
+    this->maxAdc = 1023;
+    this->referenceVoltage = 5.0;
+    this->ledPin = NO_LED_PIN;
+    this->lastMicros = 0;
+    this->elapsedMicros = 0;
+    this->mistimedReads = 0;
+}
+
+/**
+ * Restart the drift from now
+ */
+void GP2YSignalGenerator::begin()
+{
+    this->lastMicros = micros();
+    this->elapsedMicros = 0;
+}
+
+/**
+ * @param float voltage - output at zero dust
+ * @param float driftPerHour - volts per hour the zero dust voltage changes by (e.g. -0.01 as the LED ages)
+ */
+void GP2YSignalGenerator::setZeroDustVoltage(float voltage, float driftPerHour)
+{
+    this->zeroDustVoltage = voltage;
+    this->driftPerHour = driftPerHour;
+}
+
+/**
+ * @param float density - ug/m3
+ */
+void GP2YSignalGenerator::setDustDensity(float density)
+{
+    this->density = density;
+}
+
+/**
+ * @param float sensitivity - volts per 100ug/m3, 0.5 by default like the sensor
+ */
+void GP2YSignalGenerator::setSensitivity(float sensitivity)
+{
+    this->sensitivity = sensitivity;
+}
+
+/**
+ * @param float rmsVoltage - standard deviation of the gaussian noise
+ */
+void GP2YSignalGenerator::setNoise(float rmsVoltage)
+{
+    this->noise = rmsVoltage;
+}
+
+/**
+ * @param float probability - of a spike on each read, between 0 and 1
+ * @param float voltage - added by a spike
+ */
+void GP2YSignalGenerator::setSpikes(float probability, float voltage)
+{
+    this->spikeProbability = probability;
+    this->spikeVoltage = voltage;
+}
+
+/**
+ * @param uint8_t resolution - bits, 10 by default
+ * @param float referenceVoltage - 5.0 by default
+ */
+void GP2YSignalGenerator::setAdc(uint8_t resolution, float referenceVoltage)
+{
+    this->maxAdc = ((uint32_t)1 << resolution) - 1;
+    this->referenceVoltage = referenceVoltage;
+}
+
+/**
+ * Host build only: check on every read that the LED pin was set LOW 250 to 320us before,
+ * the sample point of the datasheet. Reads outside the window return 0 and are counted
+ *
+ * @param uint8_t pin - LED pin of the sensor, NO_LED_PIN disables the check
+ */
+void GP2YSignalGenerator::setLedPin(uint8_t pin)
+{
+    this->ledPin = pin;
+}
+
+/**
+ * @return float zero dust voltage including the drift so far
+ */
+float GP2YSignalGenerator::getZeroDustVoltage()
+{
+    return this->zeroDustVoltage + this->driftPerHour * (this->elapsedMicros / 3600e6f);
+}
+
+/**
+ * @return uint32_t number of reads outside of the LED pulse sample window (see setLedPin())
+ */
+uint32_t GP2YSignalGenerator::getMistimedReads()
+{
+    return this->mistimedReads;
+}
+
+/**
+ * @param uint8_t pin
+ * @return uint16_t raw ADC value of the synthetic signal
+ */
+uint16_t GP2YSignalGenerator::read(uint8_t pin)
+{
+    (void)pin;
+
+    // elapsed time survives the micros() wrap as long as reads are less than 71 minutes apart
+    uint32_t now = micros();
+    this->elapsedMicros += now - this->lastMicros;
+    this->lastMicros = now;
+
+#ifdef GP2Y_HAL_SIMULATED
+    if (this->ledPin != NO_LED_PIN) {
+        uint32_t ledOnTime = GP2YHalSim::getTimeSinceWrite(this->ledPin);
+
+        if (digitalRead(this->ledPin) != LOW || ledOnTime < 250 || ledOnTime > 320) {
+            this->mistimedReads++;
+            return 0;
+        }
+    }
+#endif
+
+    float voltage = this->getZeroDustVoltage() + this->density / 100 * this->sensitivity;
+
+    if (this->noise > 0) {
+        // Irwin-Hall approximation of a gaussian: the sum of 12 uniforms minus 6 has unit variance
+        float gaussian = -6;
+        for (uint8_t i = 0; i < 12; i++) {
+            gaussian += this->uniform();
+        }
+        voltage += gaussian * this->noise;
+    }
+
+    if (this->spikeProbability > 0 && this->uniform() < this->spikeProbability) {
+        voltage += this->spikeVoltage;
+    }
+
+    float raw = voltage / this->referenceVoltage * this->maxAdc + 0.5f;
+    if (raw < 0) {
+        return 0;
+    }
+
+    return raw > this->maxAdc ? this->maxAdc : (uint16_t)raw;
+}
+
+// xorshift32
+uint32_t GP2YSignalGenerator::nextRandom()
+{
+    this->state ^= this->state << 13;
+    this->state ^= this->state >> 17;
+    this->state ^= this->state << 5;
+
+    return this->state;
+}
+
+/**
+ * @return float uniform between 0 and 1
+ */
+float GP2YSignalGenerator::uniform()
+{
+    return (this->nextRandom() >> 8) / 16777216.0f;
+}
@@ -0,0 +1,53 @@
+#ifndef GP2Y_SIGNAL_GENERATOR_H
+#define GP2Y_SIGNAL_GENERATOR_H
+
+#include <stdint.h>
+
+#include "GP2YAdcSource.h"
+
+/**
+ * Deterministic synthetic sensor output for simulations and tests:
+ * zero dust voltage with linear drift, dust density, gaussian noise and random spikes,
+ * converted to raw ADC counts. The same seed always gives the same sequence.
+ * Use it as the analogRead() source of the host build (GP2YHalSim::setAnalogSource())
+ * or directly as the GP2YAdcSource of a sensor on real hardware.
+ */
+class GP2YSignalGenerator : public GP2YAdcSource
+{
+    private:
+        uint32_t state;
+        float zeroDustVoltage;
+        float driftPerHour;
+        float density;
+        float sensitivity;
+        float noise;
+        float spikeProbability;
+        float spikeVoltage;
+        uint16_t maxAdc;
+        float referenceVoltage;
+        uint8_t ledPin;
+        uint32_t lastMicros;
+        uint64_t elapsedMicros;
+        uint32_t mistimedReads;
+
+        uint32_t nextRandom();
+        float uniform();
+
+    public:
+        static const uint8_t NO_LED_PIN = 0xFF;
+
+        GP2YSignalGenerator(uint32_t seed = 1);
+        void begin();
+        void setZeroDustVoltage(float voltage, float driftPerHour = 0);
+        void setDustDensity(float density);
+        void setSensitivity(float sensitivity);
+        void setNoise(float rmsVoltage);
+        void setSpikes(float probability, float voltage);
+        void setAdc(uint8_t resolution, float referenceVoltage);
+        void setLedPin(uint8_t pin);
+        float getZeroDustVoltage();
+        uint32_t getMistimedReads();
+        uint16_t read(uint8_t pin);
+};
+
+#endif
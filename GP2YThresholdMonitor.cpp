@@ -0,0 +1,161 @@
+#include "GP2YThresholdMonitor.h"
+
+GP2YThresholdMonitor::GP2YThresholdMonitor()
+{
+    this->triggerCount = 0;
+    this->callback = NULL;
+    this->callbackContext = NULL;
+    this->reset();
+}
+
+/**
+ * Add a threshold trigger
+ *
+ * @param uint16_t threshold - ug/m3, ABOVE fires when the value gets higher
+ * @param uint16_t hysteresis - ug/m3, BELOW fires when the value is threshold - hysteresis or lower
+ * @param GP2YThresholdSource source - the reading or the running average
+ * @return int8_t trigger index passed to the callback, -1 if MAX_TRIGGERS are already defined
+ */
+int8_t GP2YThresholdMonitor::addThreshold(uint16_t threshold, uint16_t hysteresis, GP2YThresholdSource source)
+{
+    return this->addTrigger(TRIGGER_THRESHOLD, source, threshold, hysteresis, 0);
+}
+
+/**
+ * Add a rate of change trigger
+ *
+ * @param uint16_t maxChange - ug/m3, RATE_RISE / RATE_FALL fire when the value changes by more
+ * @param uint8_t readings - number of readings the change is measured over, 1 to MAX_RATE_READINGS
+ * @param uint16_t hysteresis - ug/m3, the trigger re-arms when the change is maxChange - hysteresis or lower
+ * @param GP2YThresholdSource source - the reading or the running average
+ * @return int8_t trigger index passed to the callback, -1 if MAX_TRIGGERS are already defined
+ */
+int8_t GP2YThresholdMonitor::addRateTrigger(uint16_t maxChange, uint8_t readings, uint16_t hysteresis,
+    GP2YThresholdSource source)
+{
+    readings = readings < 1 ? 1 : (readings > MAX_RATE_READINGS ? MAX_RATE_READINGS : readings);
+
+    return this->addTrigger(TRIGGER_RATE, source, maxChange, hysteresis, readings);
+}
+
+/**
+ * @param Callback callback - called from the sensor reading (getDustDensity(), poll(), ...) on every event
+ * @param void *context passed to the callback
+ */
+void GP2YThresholdMonitor::setCallback(Callback callback, void *context)
+{
+    this->callback = callback;
+    this->callbackContext = context;
+}
+
+/**
+ * @param uint8_t trigger index
+ * @return bool true while a threshold is exceeded or a rate trigger has not re-armed
+ */
+bool GP2YThresholdMonitor::isActive(uint8_t trigger)
+{
+    return trigger < this->triggerCount && this->triggers[trigger].active;
+}
+
+/**
+ * Forget the readings and the trigger states, the triggers are kept
+ */
+void GP2YThresholdMonitor::reset()
+{
+    for (uint8_t i = 0; i < this->triggerCount; i++) {
+        this->triggers[i].active = false;
+    }
+
+    this->historyNext = 0;
+    this->historyCount = 0;
+}
+
+/**
+ * Evaluate the triggers with a new reading, called by the sensor
+ *
+ * @param uint16_t density - ug/m3
+ * @param uint16_t runningAverage - ug/m3, NO_VALUE when the sensor has no running average
+ */
+void GP2YThresholdMonitor::addReading(uint16_t density, uint16_t runningAverage)
+{
+    this->history[GP2Y_SOURCE_DENSITY][this->historyNext] = density;
+    this->history[GP2Y_SOURCE_RUNNING_AVERAGE][this->historyNext] = runningAverage;
+    this->historyNext = (this->historyNext + 1) % (MAX_RATE_READINGS + 1);
+    if (this->historyCount <= MAX_RATE_READINGS) {
+        this->historyCount++;
+    }
+
+    for (uint8_t i = 0; i < this->triggerCount; i++) {
+        uint16_t value = this->triggers[i].source == GP2Y_SOURCE_DENSITY ? density : runningAverage;
+
+        if (value != NO_VALUE) {
+            this->evaluate(i, value);
+        }
+    }
+}
+
+int8_t GP2YThresholdMonitor::addTrigger(uint8_t type, uint8_t source, uint16_t limit, uint16_t hysteresis, uint8_t readings)
+{
+    if (this->triggerCount >= MAX_TRIGGERS) {
+        return -1;
+    }
+
+    Trigger &trigger = this->triggers[this->triggerCount];
+    trigger.type = type;
+    trigger.source = source;
+    trigger.readings = readings;
+    trigger.active = false;
+    trigger.limit = limit;
+    trigger.hysteresis = hysteresis > limit ? limit : hysteresis;
+
+    return this->triggerCount++;
+}
+
+void GP2YThresholdMonitor::evaluate(uint8_t index, uint16_t value)
+{
+    Trigger &trigger = this->triggers[index];
+    GP2YThresholdEvent event;
+
+    if (trigger.type == TRIGGER_THRESHOLD) {
+        if (!trigger.active && value > trigger.limit) {
+            event = GP2Y_EVENT_ABOVE;
+        } else if (trigger.active && value <= trigger.limit - trigger.hysteresis) {
+            event = GP2Y_EVENT_BELOW;
+        } else {
+            return;
+        }
+        trigger.active = event == GP2Y_EVENT_ABOVE;
+    } else {
+        if (this->historyCount <= trigger.readings) {
+            return;
+        }
+
+        // the current value is at historyNext - 1
+        uint8_t oldIndex = (this->historyNext + MAX_RATE_READINGS - trigger.readings) % (MAX_RATE_READINGS + 1);
+        uint16_t oldValue = this->history[trigger.source][oldIndex];
+        if (oldValue == NO_VALUE) {
+            return;
+        }
+
+        int32_t change = (int32_t)value - oldValue;
+        uint16_t magnitude = change < 0 ? -change : change;
+
+        if (trigger.active) {
+            // re-arm silently
+            if (magnitude <= trigger.limit - trigger.hysteresis) {
+                trigger.active = false;
+            }
+            return;
+        }
+
+        if (magnitude <= trigger.limit) {
+            return;
+        }
+        trigger.active = true;
+        event = change > 0 ? GP2Y_EVENT_RATE_RISE : GP2Y_EVENT_RATE_FALL;
+    }
+
+    if (this->callback) {
+        this->callback(event, index, value, this->callbackContext);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef GP2Y_THRESHOLD_MONITOR_H
+#define GP2Y_THRESHOLD_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum GP2YThresholdEvent
+{
+    GP2Y_EVENT_ABOVE,       // the value rose above the threshold
+    GP2Y_EVENT_BELOW,       // the value fell back below the threshold minus the hysteresis
+    GP2Y_EVENT_RATE_RISE,   // the value rose faster than the rate trigger allows
+    GP2Y_EVENT_RATE_FALL    // the value fell faster than the rate trigger allows
+};
+
+enum GP2YThresholdSource
+{
+    GP2Y_SOURCE_DENSITY,        // each reading, as returned by getDustDensity()
+    GP2Y_SOURCE_RUNNING_AVERAGE // the running (or exponential) average
+};
+
+/**
+ * Threshold and rate of change triggers, evaluated with every reading of the sensor it is attached to
+ * (see GP2YDustSensor::setThresholdMonitor()). The callback fires only when a trigger changes state,
+ * so the application doesn't need to poll the readings.
+ * - threshold: fires ABOVE when the value exceeds the threshold, then BELOW once it drops to
+ *   threshold - hysteresis or lower. The hysteresis avoids repeated events around the threshold
+ * - rate: fires RATE_RISE / RATE_FALL when the value changed by more than maxChange over the last
+ *   readings, re-armed once the change is back to maxChange - hysteresis
+ * Values are in ug/m3.
+ */
+class GP2YThresholdMonitor
+{
+    public:
+        typedef void (*Callback)(GP2YThresholdEvent event, uint8_t trigger, uint16_t value, void *context);
+
+        static const uint8_t MAX_TRIGGERS = 4;
+        static const uint8_t MAX_RATE_READINGS = 16;
+        static const uint16_t NO_VALUE = 0xFFFF;
+
+    private:
+        enum TriggerType
+        {
+            TRIGGER_THRESHOLD,
+            TRIGGER_RATE
+        };
+
+        struct Trigger
+        {
+            uint8_t type;
+            uint8_t source;
+            uint8_t readings;
+            bool active;
+            uint16_t limit;
+            uint16_t hysteresis;
+        };
+
+        Trigger triggers[MAX_TRIGGERS];
+        uint8_t triggerCount;
+        // recent values of each source for the rate triggers, newest at historyNext - 1
+        uint16_t history[2][MAX_RATE_READINGS + 1];
+        uint8_t historyNext;
+        uint8_t historyCount;
+        Callback callback;
+        void *callbackContext;
+
+        int8_t addTrigger(uint8_t type, uint8_t source, uint16_t limit, uint16_t hysteresis, uint8_t readings);
+        void evaluate(uint8_t index, uint16_t value);
+
+    public:
+        GP2YThresholdMonitor();
+        int8_t addThreshold(uint16_t threshold, uint16_t hysteresis = 0, GP2YThresholdSource source = GP2Y_SOURCE_DENSITY);
+        int8_t addRateTrigger(uint16_t maxChange, uint8_t readings, uint16_t hysteresis = 0,
+            GP2YThresholdSource source = GP2Y_SOURCE_DENSITY);
+        void setCallback(Callback callback, void *context = NULL);
+        bool isActive(uint8_t trigger);
+        void reset();
+        void addReading(uint16_t density, uint16_t runningAverage = NO_VALUE);
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include "GP2YHal.h"
+
+#include "GP2YTimerEngine.h"
+
+GP2YDustSensor *GP2YTimerEngine::sensor = NULL;
+
+#if GP2Y_TIMER_ENGINE && defined(ESP32)
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static esp_timer_handle_t gp2yTimer = NULL;
+static int64_t gp2yNextDeadline;
+// the callback runs in the esp_timer task, possibly on the other core while end() runs:
+// end() raises gp2yStopping and waits for the callback to be idle before detaching the sensor
+static volatile bool gp2yStopping = false;
+static volatile bool gp2yCallbackBusy = false;
+
+static void gp2yTimerCallback(void *)
+{
+    gp2yCallbackBusy = true;
+    GP2Y_MEMORY_BARRIER();
+
+    if (!gp2yStopping) {
+        // schedule against absolute deadlines so the callback latency does not accumulate
+        gp2yNextDeadline += GP2YTimerEngine::tick();
+        int64_t delay = gp2yNextDeadline - esp_timer_get_time();
+        esp_timer_start_once(gp2yTimer, delay > 0 ? delay : 1);
+    }
+
+    GP2Y_MEMORY_BARRIER();
+    gp2yCallbackBusy = false;
+}
+
+// esp_timer callbacks run in a task, the flash is always accessible
+static bool gp2yTimerCanSample(GP2YAdcSource *)
+{
+    return true;
+}
+
+static GP2YIsrReadFunction gp2yTimerIsrRead(GP2YAdcSource *)
+{
+    return NULL;
+}
+
+static bool gp2yTimerStart()
+{
+    if (!gp2yTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = &gp2yTimerCallback;
+        args.name = "gp2y";
+
+        if (esp_timer_create(&args, &gp2yTimer) != ESP_OK) {
+            gp2yTimer = NULL;
+            return false;
+        }
+    }
+
+    gp2yNextDeadline = esp_timer_get_time();
+    gp2yStopping = false;
+    GP2Y_MEMORY_BARRIER();
+
+    return esp_timer_start_once(gp2yTimer, 1) == ESP_OK;
+}
+
+static void gp2yTimerStop()
+{
+    gp2yStopping = true;
+    GP2Y_MEMORY_BARRIER();
+
+    // a callback already past the check finishes its tick and may re-arm the timer, stop it after that
+    while (gp2yCallbackBusy) {
+        vTaskDelay(1);
+    }
+    esp_timer_stop(gp2yTimer);
+}
+
+#elif GP2Y_TIMER_ENGINE && defined(ESP8266)
+
+// timer1 runs at 80MHz / 16 = 5 ticks per microsecond
+static const uint32_t GP2Y_TIMER1_TICKS_PER_US = 5;
+
+// the timer1 interrupt fires while the flash cache is disabled (flash writes, WiFi), where calling
+// analogRead() (system_adc_read() lives in flash) crashes. Only run with a source placed in IRAM
+static bool gp2yTimerCanSample(GP2YAdcSource *adcSource)
+{
+    return adcSource && adcSource->isIsrSafe() && adcSource->getIsrReadFunction();
+}
+
+// the vtable of the source is in flash too, resolve the read function once outside of the interrupt
+static GP2YIsrReadFunction gp2yTimerIsrRead(GP2YAdcSource *adcSource)
+{
+    return adcSource->getIsrReadFunction();
+}
+
+static void GP2Y_ISR_ATTR gp2yTimerIsr()
+{
+    timer1_write(GP2YTimerEngine::tick() * GP2Y_TIMER1_TICKS_PER_US);
+}
+
+static bool gp2yTimerStart()
+{
+    timer1_isr_init();
+    timer1_attachInterrupt(gp2yTimerIsr);
+    timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+    timer1_write(GP2Y_TIMER1_TICKS_PER_US * 10);
+
+    return true;
+}
+
+static void gp2yTimerStop()
+{
+    timer1_disable();
+    timer1_detachInterrupt();
+}
+
+#elif GP2Y_TIMER_ENGINE && defined(__AVR__)
+
+#include <avr/interrupt.h>
+
+// Timer1 in CTC mode with a /8 prescaler: 2 ticks per microsecond at 16MHz
+#define GP2Y_TIMER1_TICKS(us) ((uint32_t)(us) * (F_CPU / 1000000UL) / 8)
+
+ISR(TIMER1_COMPA_vect)
+{
+    // the counter was reset on the compare match, so the new period starts at this tick
+    OCR1A = GP2Y_TIMER1_TICKS(GP2YTimerEngine::tick()) - 1;
+}
+
+static bool gp2yTimerCanSample(GP2YAdcSource *)
+{
+    return true;
+}
+
+static GP2YIsrReadFunction gp2yTimerIsrRead(GP2YAdcSource *)
+{
+    return NULL;
+}
+
+static bool gp2yTimerStart()
+{
+    noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS11);
+    TCNT1 = 0;
+    OCR1A = GP2Y_TIMER1_TICKS(100) - 1;
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 |= _BV(OCIE1A);
+    interrupts();
+
+    return true;
+}
+
+static void gp2yTimerStop()
+{
+    TIMSK1 &= ~_BV(OCIE1A);
+    TCCR1B = 0;
+}
+
+#else
+
+// no timer backend for this platform (or disabled from GP2YConfig.h)
+static bool gp2yTimerCanSample(GP2YAdcSource *)
+{
+    return false;
+}
+
+static GP2YIsrReadFunction gp2yTimerIsrRead(GP2YAdcSource *)
+{
+    return NULL;
+}
+
+static bool gp2yTimerStart()
+{
+    return false;
+}
+
+static void gp2yTimerStop()
+{
+}
+
+#endif
+
+/**
+ * Start timer driven sampling for the sensor. The sensor must be initialized with begin() first.
+ * On ESP8266 the sensor needs a GP2YAdcSource whose isIsrSafe() returns true and with an IRAM
+ * read function (getIsrReadFunction()), see gp2yTimerCanSample()
+ *
+ * @param GP2YDustSensor *sensor
+ * @param GP2YSampleRing *ring buffer receiving the raw samples, owned by the caller
+ * @return bool false if there is no timer backend for this platform, the ADC can't be read from the timer
+ * interrupt or the engine is already running
+ */
+bool GP2YTimerEngine::begin(GP2YDustSensor *sensor, GP2YSampleRing *ring)
+{
+    if (GP2YTimerEngine::sensor || !sensor || !ring || !gp2yTimerCanSample(sensor->adcSource)) {
+        return false;
+    }
+
+    sensor->timerLedOn = false;
+    sensor->isrRead = gp2yTimerIsrRead(sensor->adcSource);
+    sensor->sampleRing = ring;
+    GP2YTimerEngine::sensor = sensor;
+
+    if (!gp2yTimerStart()) {
+        sensor->isrRead = NULL;
+        sensor->sampleRing = NULL;
+        GP2YTimerEngine::sensor = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Stop timer driven sampling. The sensor goes back to busy-wait / poll() sampling
+ */
+void GP2YTimerEngine::end()
+{
+    if (!GP2YTimerEngine::sensor) {
+        return;
+    }
+
+    // returns once no tick runs anymore, the sensor can be detached safely
+    gp2yTimerStop();
+
+    // don't leave the LED on if we stopped in the middle of a pulse
+    digitalWrite(GP2YTimerEngine::sensor->ledOutputPin, HIGH);
+    GP2YTimerEngine::sensor->timerLedOn = false;
+    GP2YTimerEngine::sensor->isrRead = NULL;
+    GP2YTimerEngine::sensor->sampleRing = NULL;
+    GP2YTimerEngine::sensor = NULL;
+}
+
+bool GP2YTimerEngine::isRunning()
+{
+    return GP2YTimerEngine::sensor != NULL;
+}
+
+/**
+ * Advance the pulse of the driven sensor. Called from the timer interrupt
+ *
+ * @return uint32_t microseconds until the next tick
+ */
+GP2Y_ISR_ATTR uint32_t GP2YTimerEngine::tick()
+{
+    GP2YDustSensor *sensor = GP2YTimerEngine::sensor;
+
+    if (!sensor) {
+        return GP2YDustSensor::SAMPLE_CYCLE_US;
+    }
+
+    return sensor->onTimerTick();
+}
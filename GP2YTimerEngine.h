@@ -0,0 +1,29 @@
+#ifndef GP2Y_TIMER_ENGINE_H
+#define GP2Y_TIMER_ENGINE_H
+
+#include <stdint.h>
+
+#include "GP2YDustSensor.h"
+#include "GP2YSampleRing.h"
+
+/**
+ * Drives the LED pulse and the ADC read of one sensor from a hardware timer
+ * (ESP32 esp_timer, ESP8266 timer1, AVR Timer1) with an exact 10ms cadence.
+ * The raw samples are pushed into a GP2YSampleRing which getDustDensity() and poll() drain,
+ * so no foreground CPU is used while sampling.
+ * Only one sensor can be driven at a time since there is a single timer.
+ * Enable it on AVR with GP2Y_TIMER_ENGINE (see GP2YConfig.h)
+ */
+class GP2YTimerEngine
+{
+    private:
+        static GP2YDustSensor *sensor;
+
+    public:
+        static bool begin(GP2YDustSensor *sensor, GP2YSampleRing *ring);
+        static void end();
+        static bool isRunning();
+        static uint32_t tick();
+};
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * Measures the cost of the library on the board, to choose numSamples and the running average size
+ * and to compare library versions: CPU cycles per conversion (without the sampling delays),
+ * getRunningAverage() cycles, blocking time of getDustDensity() and RAM per configuration.
+ * No sensor needs to be connected. Every result is printed as "bench <name> <value> <unit>".
+ * extras/benchmark runs the same measurements on a host computer.
+ */
+#include <GP2YDustSensor.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+const uint16_t ITERATIONS = 1000;
+
+#if defined(__AVR__)
+const uint16_t RUNNING_AVERAGE_COUNTS[] = {0, 10, 60, 300};
+#else
+const uint16_t RUNNING_AVERAGE_COUNTS[] = {0, 10, 60, 300, 3600};
+#endif
+const uint16_t SAMPLE_COUNTS[] = {1, 20, 100};
+
+// exposes the conversion of a raw sum, which getDustDensity() runs after sampling
+class BenchSensor : public GP2YDustSensor
+{
+    public:
+        BenchSensor(uint16_t runningAverageCount)
+            : GP2YDustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, runningAverageCount)
+        {
+        }
+
+        uint16_t convert(uint32_t total, uint16_t numSamples)
+        {
+            return this->processSamples(total, numSamples);
+        }
+};
+
+#if defined(ESP32) || defined(ESP8266)
+uint32_t cycleCount() {
+  return ESP.getCycleCount();
+}
+#else
+// no cycle counter on AVR, micros() has a 4us resolution but is averaged over ITERATIONS calls
+uint32_t cycleCount() {
+  return micros() * (F_CPU / 1000000UL);
+}
+#endif
+
+uint32_t freeHeap() {
+#if defined(ESP32) || defined(ESP8266)
+  return ESP.getFreeHeap();
+#elif defined(__AVR__)
+  extern int __heap_start, *__brkval;
+  int top;
+  return (int)&top - (__brkval == 0 ? (int)&__heap_start : (int)__brkval);
+#else
+  return 0;
+#endif
+}
+
+void report(const char *name, uint16_t parameter, uint32_t value, const char *unit) {
+  Serial.print("bench ");
+  Serial.print(name);
+  Serial.print("[");
+  Serial.print(parameter);
+  Serial.print("] ");
+  Serial.print(value);
+  Serial.print(" ");
+  Serial.println(unit);
+}
+
+void benchRunningAverage(uint16_t count) {
+  uint32_t heapBefore = freeHeap();
+  BenchSensor *sensor = new BenchSensor(count);
+  report("heap", count, heapBefore - freeHeap(), "bytes");
+
+  // fill the running average so every path is taken
+  for (uint16_t i = 0; i < count; i++) {
+    sensor->convert(20 * 180, 20);
+  }
+
+  volatile uint16_t result;
+  uint32_t start = cycleCount();
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    result = sensor->convert(20 * 180 + (i & 15), 20);
+  }
+  report("conversion", count, (cycleCount() - start) / ITERATIONS, "cycles");
+
+  start = cycleCount();
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    result = sensor->getRunningAverage();
+  }
+  report("running_average", count, (cycleCount() - start) / ITERATIONS, "cycles");
+  (void)result;
+
+  delete sensor;
+}
+
+void benchBlocking(uint16_t numSamples, GP2YDustSensor &sensor) {
+  uint32_t start = micros();
+  sensor.getDustDensity(numSamples);
+  report("blocking", numSamples, micros() - start, "us");
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  report("sizeof_sensor", 0, sizeof(GP2YDustSensor), "bytes");
+  report("sizeof_static_sensor", 60, sizeof(GP2YStaticDustSensor<60>), "bytes");
+
+  for (uint8_t i = 0; i < sizeof(RUNNING_AVERAGE_COUNTS) / sizeof(RUNNING_AVERAGE_COUNTS[0]); i++) {
+    benchRunningAverage(RUNNING_AVERAGE_COUNTS[i]);
+  }
+
+  GP2YDustSensor sensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+  sensor.begin();
+  for (uint8_t i = 0; i < sizeof(SAMPLE_COUNTS) / sizeof(SAMPLE_COUNTS[0]); i++) {
+    benchBlocking(SAMPLE_COUNTS[i], sensor);
+  }
+
+  Serial.println("bench done");
+}
+
+void loop() {
+}
@@ -0,0 +1,82 @@
+#include <GP2YDustSensor.h>
+#include <GP2YCalibrationFitter.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+
+const uint16_t CALIBRATION_PAIRS = 60;
+const uint32_t READ_INTERVAL_MS = 1000;
+
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1010AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+GP2YCalibrationFitter fitter;
+
+char lineBuffer[16];
+uint8_t lineLength = 0;
+
+// sensor average since the last reference value
+uint32_t lastReadingTime = 0;
+float voltageSum = 0;
+uint16_t voltageCount = 0;
+
+/**
+ * Read one line of the serial port, without blocking
+ *
+ * @return bool true when a complete line is in lineBuffer
+ */
+bool readLine() {
+  while (Serial.available()) {
+    char c = Serial.read();
+
+    if (c == '\n' || c == '\r') {
+      if (lineLength == 0) {
+        continue;
+      }
+      lineBuffer[lineLength] = 0;
+      lineLength = 0;
+      return true;
+    }
+
+    if (lineLength < sizeof(lineBuffer) - 1) {
+      lineBuffer[lineLength++] = c;
+    }
+  }
+
+  return false;
+}
+
+void setup() {
+  Serial.begin(9600);
+  dustSensor.begin();
+  Serial.println("Send the reference density (ug/m3) averaged over the last minute, once per minute");
+}
+
+void loop() {
+  // sample continuously, the sensor average covers the same interval as the reference value
+  if (millis() - lastReadingTime >= READ_INTERVAL_MS) {
+    lastReadingTime = millis();
+    GP2YDustReading reading = dustSensor.getDustReading();
+    voltageSum += reading.voltageMicrovolts / 1e6;
+    voltageCount++;
+  }
+
+  if (!readLine() || !voltageCount) {
+    return;
+  }
+
+  // pair the reference with the sensor average of the interval that just ended, then start the next one
+  fitter.addPair(voltageSum / voltageCount, atof(lineBuffer));
+  voltageSum = 0;
+  voltageCount = 0;
+
+  Serial.print("Pairs: ");
+  Serial.println(fitter.getCount());
+
+  if (fitter.getCount() == CALIBRATION_PAIRS && fitter.applyTo(&dustSensor)) {
+    Serial.print("Sensitivity: ");
+    Serial.print(fitter.getSensitivity(), 4);
+    Serial.print(" V/100ug/m3; Baseline: ");
+    Serial.print(fitter.getZeroDustVoltage(), 4);
+    Serial.print(" V; R2: ");
+    Serial.println(fitter.getRSquared(), 4);
+  }
+}
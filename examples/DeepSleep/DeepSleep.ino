@@ -0,0 +1,67 @@
+#include <GP2YDustSensor.h>
+#include <GP2YBaselineTracker.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+const uint64_t SLEEP_TIME_US = 60e6; // wake up every minute
+
+// 60 readings = 1 hour running average at one reading per minute
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, 60);
+// 24h drift correction: 24 buckets of 60 readings
+GP2YBaselineTracker baselineTracker(60, 24);
+
+#if defined(ESP32)
+// RTC memory is kept during deep sleep
+RTC_DATA_ATTR uint8_t sensorState[256];
+RTC_DATA_ATTR uint8_t trackerState[160];
+RTC_DATA_ATTR bool hasSensorState = false;
+#elif defined(ESP8266)
+// ESP.rtcUserMemoryRead/Write work with 4 byte blocks, 128 blocks in total
+uint32_t sensorState[64];
+uint32_t trackerState[40];
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  dustSensor.setBaselineTracker(&baselineTracker);
+  dustSensor.begin();
+
+#if defined(ESP32)
+  if (hasSensorState) {
+    dustSensor.restoreState(sensorState, sizeof(sensorState));
+    baselineTracker.restoreState(trackerState, sizeof(trackerState));
+  }
+#elif defined(ESP8266)
+  // RTC memory holds garbage after a cold boot and rtcUserMemoryRead() still succeeds (it only fails
+  // on a bad offset or size), so only restore when waking up from deep sleep.
+  // restoreState() checks the checksum as well.
+  if (ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE) {
+    ESP.rtcUserMemoryRead(0, sensorState, sizeof(sensorState));
+    ESP.rtcUserMemoryRead(sizeof(sensorState) / 4, trackerState, sizeof(trackerState));
+    dustSensor.restoreState((uint8_t *)sensorState, sizeof(sensorState));
+    baselineTracker.restoreState((uint8_t *)trackerState, sizeof(trackerState));
+  }
+#endif
+
+  // short burst, then straight back to sleep
+  Serial.print("Dust density: ");
+  Serial.print(dustSensor.getDustDensity(10));
+  Serial.print(" ug/m3; 1h average: ");
+  Serial.print(dustSensor.getRunningAverage());
+  Serial.println(" ug/m3");
+
+#if defined(ESP32)
+  hasSensorState = dustSensor.saveState(sensorState, sizeof(sensorState)) > 0
+    && baselineTracker.saveState(trackerState, sizeof(trackerState)) > 0;
+  esp_deep_sleep(SLEEP_TIME_US);
+#elif defined(ESP8266)
+  dustSensor.saveState((uint8_t *)sensorState, sizeof(sensorState));
+  baselineTracker.saveState((uint8_t *)trackerState, sizeof(trackerState));
+  ESP.rtcUserMemoryWrite(0, sensorState, sizeof(sensorState));
+  ESP.rtcUserMemoryWrite(sizeof(sensorState) / 4, trackerState, sizeof(trackerState));
+  ESP.deepSleep(SLEEP_TIME_US);
+#endif
+}
+
+void loop() {
+}
@@ -0,0 +1,52 @@
+#include <SPI.h>
+#include <GP2YDustSensor.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t ADC_CS_PIN = 5;       // chip select of the external ADC
+
+/**
+ * Reads the sensor output through an MCP3201 12 bit SPI ADC (100ksps, a conversion takes ~15us).
+ * Slow converters like the ADS1115 (1.2ms per conversion at 860SPS) can't sample inside the 320us LED pulse.
+ */
+class MCP3201AdcSource : public GP2YAdcSource
+{
+  public:
+    void begin() {
+      pinMode(ADC_CS_PIN, OUTPUT);
+      digitalWrite(ADC_CS_PIN, HIGH);
+      SPI.begin();
+    }
+
+    uint16_t read(uint8_t pin) {
+      SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
+      digitalWrite(ADC_CS_PIN, LOW);
+      uint8_t high = SPI.transfer(0);
+      uint8_t low = SPI.transfer(0);
+      digitalWrite(ADC_CS_PIN, HIGH);
+      SPI.endTransaction();
+
+      // 2 clocks sampling, a null bit, then 12 data bits MSB first
+      return ((high & 0x1F) << 7) | (low >> 1);
+    }
+};
+
+MCP3201AdcSource adcSource;
+// the analog pin is not used by the external ADC
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, 0);
+
+void setup() {
+  Serial.begin(9600);
+  dustSensor.setAdcSource(&adcSource);
+  dustSensor.setAdcResolution(12);
+  dustSensor.setAdcReferenceVoltage(5.0);
+  dustSensor.begin();
+}
+
+void loop() {
+  Serial.print("Dust density: ");
+  Serial.print(dustSensor.getDustDensity());
+  Serial.print(" ug/m3; Running average: ");
+  Serial.print(dustSensor.getRunningAverage());
+  Serial.println(" ug/m3");
+  delay(1000);
+}
@@ -0,0 +1,130 @@
+#include <GP2YDustSensor.h>
+#include <GP2YDustAggregator.h>
+#include <GP2YFlashLog.h>
+#include <LittleFS.h>
+#include <time.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+
+/**
+ * GP2YFlashStorage on a preallocated LittleFS file.
+ * LittleFS spreads the file writes over the flash itself, the log only appends and erases
+ * whole sectors, so the file is never rewritten in small pieces.
+ */
+class LittleFsStorage : public GP2YFlashStorage
+{
+    private:
+        File file;
+
+    public:
+        static const uint16_t SECTOR_COUNT = 16;
+        static const uint16_t SECTOR_SIZE = 4096;
+
+        bool begin(const char *path)
+        {
+            if (!LittleFS.exists(path)) {
+                this->file = LittleFS.open(path, "w");
+                for (uint16_t sector = 0; sector < SECTOR_COUNT; sector++) {
+                    this->erase(sector);
+                }
+                this->file.close();
+            }
+            this->file = LittleFS.open(path, "r+");
+
+            return this->file;
+        }
+
+        uint16_t getSectorCount() { return SECTOR_COUNT; }
+        uint16_t getSectorSize() { return SECTOR_SIZE; }
+
+        bool read(uint32_t address, uint8_t *data, uint16_t size)
+        {
+            return this->file.seek(address) && this->file.read(data, size) == size;
+        }
+
+        bool write(uint32_t address, const uint8_t *data, uint16_t size)
+        {
+            bool success = this->file.seek(address) && this->file.write(data, size) == size;
+            this->file.flush();
+
+            return success;
+        }
+
+        bool erase(uint16_t sector)
+        {
+            uint8_t erased[64];
+            memset(erased, 0xFF, sizeof(erased));
+
+            if (!this->file.seek((uint32_t)sector * SECTOR_SIZE)) {
+                return false;
+            }
+            for (uint16_t i = 0; i < SECTOR_SIZE; i += sizeof(erased)) {
+                if (this->file.write(erased, sizeof(erased)) != sizeof(erased)) {
+                    return false;
+                }
+            }
+            this->file.flush();
+
+            return true;
+        }
+};
+
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+GP2YDustAggregator aggregator(60); // one reading per second
+LittleFsStorage storage;
+GP2YFlashLog dustLog(&storage); // 15 x 340 minutes kept, about 3.5 days
+
+uint32_t lastUploaded = 0;
+uint8_t secondsInMinute = 0;
+
+// send everything logged since the last upload, e.g. once the network is back
+void uploadBacklog() {
+  GP2YDustRecord record;
+
+  if (!dustLog.seek(lastUploaded + 1)) {
+    return;
+  }
+
+  while (dustLog.read(record)) {
+    Serial.print(record.timestamp);
+    Serial.print(": ");
+    Serial.print(record.density);
+    Serial.println(" ug/m3");
+    lastUploaded = record.timestamp;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  // timestamps must not go backwards, set the clock first (NTP, RTC)
+  LittleFS.begin();
+  storage.begin("/dust.log");
+  dustLog.begin();
+
+  dustSensor.setAggregator(&aggregator);
+  dustSensor.begin();
+}
+
+void loop() {
+  dustSensor.getDustDensity();
+
+  if (++secondsInMinute >= 60) {
+    secondsInMinute = 0;
+
+    GP2YDustRecord record;
+    record.timestamp = time(NULL);
+    record.density = aggregator.getAverage(GP2Y_WINDOW_1_MINUTE);
+    record.baseline = dustSensor.getBaseline() * 1000;
+    record.flags = 0;
+    dustLog.append(record);
+
+    if (Serial.available()) {
+      Serial.read();
+      uploadBacklog();
+    }
+  }
+
+  delay(800); // getDustDensity() takes about 200ms
+}
@@ -0,0 +1,34 @@
+#include <GP2YDustSensor.h>
+#include <GP2YDustSensorGroup.h>
+
+GP2YDustSensor intake(GP2YDustSensorType::GP2Y1014AU0F, 2, A0);
+GP2YDustSensor exhaust(GP2YDustSensorType::GP2Y1014AU0F, 3, A1);
+GP2YDustSensor zone1(GP2YDustSensorType::GP2Y1014AU0F, 4, A2);
+GP2YDustSensor zone2(GP2YDustSensorType::GP2Y1014AU0F, 5, A3);
+GP2YDustSensorGroup sensors;
+
+void setup() {
+  Serial.begin(9600);
+  sensors.add(&intake);
+  sensors.add(&exhaust);
+  sensors.add(&zone1);
+  sensors.add(&zone2);
+  sensors.begin();
+}
+
+void loop() {
+  // all 4 sensors are read in 200ms
+  sensors.readAll();
+
+  for (uint8_t i = 0; i < sensors.getSensorCount(); i++) {
+    Serial.print("Sensor ");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(sensors.getDustDensity(i));
+    Serial.print(" ug/m3; Running average: ");
+    Serial.print(sensors.getRunningAverage(i));
+    Serial.println(" ug/m3");
+  }
+
+  delay(1000);
+}
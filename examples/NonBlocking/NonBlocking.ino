@@ -0,0 +1,31 @@
+#include <GP2YDustSensor.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+unsigned long lastMeasurement = 0;
+
+void setup() {
+  Serial.begin(9600);
+  dustSensor.begin();
+}
+
+void loop() {
+  // start a new measurement every second
+  if (millis() - lastMeasurement >= 1000) {
+    lastMeasurement = millis();
+    dustSensor.startMeasurement();
+  }
+
+  if (!dustSensor.isReady() && dustSensor.poll()) {
+    Serial.print("Dust density: ");
+    Serial.print(dustSensor.getLastDensity());
+    Serial.print(" ug/m3; Running average: ");
+    Serial.print(dustSensor.getRunningAverage());
+    Serial.println(" ug/m3");
+  }
+
+  // other work (WiFi, MQTT) goes here, just don't block for more than ~100 microseconds
+  // while the LED pulse is active
+}
@@ -0,0 +1,49 @@
+/**
+ * ESP32 only: the sensor is sampled by a FreeRTOS task on core 0,
+ * loop() receives the readings 10 at a time through a queue
+ */
+#include <GP2YDustSensor.h>
+#include <GP2YSamplingTask.h>
+
+#if !defined(ESP32)
+#error "GP2YSamplingTask needs the ESP32 FreeRTOS"
+#endif
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = 34;    // Sharp Dust/particle analog out pin used for reading 
+
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+GP2YSamplingTask samplingTask(&dustSensor);
+QueueHandle_t readingQueue;
+
+void setup() {
+  Serial.begin(115200);
+
+  dustSensor.setAdcResolution(12);
+  dustSensor.setAdcReferenceVoltage(3.3);
+  dustSensor.begin();
+
+  readingQueue = GP2YSamplingTask::createQueue(2);
+  samplingTask.setQueue(readingQueue);
+  samplingTask.setBatchSize(10);
+  // 20 samples every second, on core 0
+  samplingTask.begin(20, 1000, 0);
+}
+
+void loop() {
+  GP2YDustBatch batch;
+
+  // wakes up every 10 seconds
+  if (xQueueReceive(readingQueue, &batch, portMAX_DELAY) == pdTRUE) {
+    for (uint8_t i = 0; i < batch.count; i++) {
+      Serial.print(batch.readings[i].densityQ8 / 256.0);
+      Serial.print(" ");
+    }
+    Serial.println("ug/m3");
+
+    // the running average is maintained by the sampling task, read it through the snapshot
+    Serial.print("Running average: ");
+    Serial.print(dustSensor.getSnapshot().runningAverage);
+    Serial.println(" ug/m3");
+  }
+}
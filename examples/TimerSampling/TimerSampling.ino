@@ -0,0 +1,30 @@
+#include <GP2YDustSensor.h>
+#include <GP2YTimerEngine.h>
+
+const uint8_t SHARP_LED_PIN = 14;   // Sharp Dust/particle sensor Led Pin
+const uint8_t SHARP_VO_PIN = A0;    // Sharp Dust/particle analog out pin used for reading 
+
+GP2YDustSensor dustSensor(GP2YDustSensorType::GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+GP2YSampleRing sampleRing;
+
+void setup() {
+  Serial.begin(9600);
+  dustSensor.begin();
+
+  // the LED pulses and the ADC reads now happen in the timer interrupt, every 10ms
+  // (on ESP8266 only with a GP2YAdcSource placed in IRAM, analogRead() can't be called from the interrupt)
+  if (!GP2YTimerEngine::begin(&dustSensor, &sampleRing)) {
+    Serial.println("Timer engine not available, falling back to busy-wait sampling");
+  }
+}
+
+void loop() {
+  // the ring holds 320ms of samples (GP2Y_SAMPLE_RING_SIZE), read at least that often
+  // or older samples are discarded and getDustDensity() waits for fresh ones
+  Serial.print("Dust density: ");
+  Serial.print(dustSensor.getDustDensity());
+  Serial.print(" ug/m3; Running average: ");
+  Serial.print(dustSensor.getRunningAverage());
+  Serial.println(" ug/m3");
+  delay(250);
+}
@@ -0,0 +1,214 @@
+/**
+ * Host version of examples/Benchmark, built against the simulated HAL (see GP2YHal.h).
+ * Reports the conversion and getRunningAverage() cost in ns, the simulated blocking time
+ * of getDustDensity() and the heap used per running average size, as "bench <name> <value> <unit>".
+ * Given a previous output, prints the change of every result and exits with 1 if a
+ * deterministic result (bytes, simulated us) got worse.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++11 -O2 -DGP2Y_HAL_SIMULATED -I../.. benchmark.cpp ../../GP2Y*.cpp -o benchmark
+ *   ./benchmark > baseline.txt
+ *   ./benchmark baseline.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+
+#include "GP2YHal.h"
+#include "GP2YDustSensor.h"
+
+const uint8_t SHARP_LED_PIN = 14;
+const uint8_t SHARP_VO_PIN = A0;
+const uint32_t ITERATIONS = 1000000;
+const uint8_t RUNS = 5;
+const uint16_t RUNNING_AVERAGE_COUNTS[] = {0, 10, 60, 300, 3600};
+const uint16_t SAMPLE_COUNTS[] = {1, 20, 100};
+const uint8_t MAX_RESULTS = 32;
+
+// heap accounting: every allocation is prefixed with its size, not inlined so the
+// compiler does not mistake the offset header for an out of bounds access
+static size_t allocatedBytes = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    size_t *block = (size_t *)malloc(size + sizeof(max_align_t));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *block = size;
+    allocatedBytes += size;
+
+    return (uint8_t *)block + sizeof(max_align_t);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept
+{
+    if (pointer) {
+        size_t *block = (size_t *)((uint8_t *)pointer - sizeof(max_align_t));
+        allocatedBytes -= *block;
+        free(block);
+    }
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+// exposes the conversion of a raw sum, which getDustDensity() runs after sampling
+class BenchSensor : public GP2YDustSensor
+{
+    public:
+        BenchSensor(uint16_t runningAverageCount)
+            : GP2YDustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, runningAverageCount)
+        {
+        }
+
+        uint16_t convert(uint32_t total, uint16_t numSamples)
+        {
+            return this->processSamples(total, numSamples);
+        }
+};
+
+struct Result
+{
+    char name[48];
+    double value;
+    char unit[8];
+};
+
+static Result results[MAX_RESULTS];
+static uint8_t resultCount = 0;
+
+static void report(const char *name, uint16_t parameter, double value, const char *unit)
+{
+    if (resultCount >= MAX_RESULTS) {
+        return;
+    }
+
+    Result &result = results[resultCount++];
+    snprintf(result.name, sizeof(result.name), "%s[%u]", name, parameter);
+    result.value = value;
+    snprintf(result.unit, sizeof(result.unit), "%s", unit);
+}
+
+// best of RUNS, the least disturbed by the OS
+template <typename Function>
+static double nanosecondsPerCall(Function function)
+{
+    double best = 0;
+
+    for (uint8_t run = 0; run < RUNS; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < ITERATIONS; i++) {
+            function(i);
+        }
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        if (!run || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return best / ITERATIONS;
+}
+
+static void benchRunningAverage(uint16_t count)
+{
+    volatile uint16_t result;
+    size_t heapBefore = allocatedBytes;
+    BenchSensor *sensor = new BenchSensor(count);
+    report("heap", count, allocatedBytes - heapBefore, "bytes");
+
+    // fill the running average so every path is taken
+    for (uint16_t i = 0; i < count; i++) {
+        sensor->convert(20 * 180, 20);
+    }
+
+    report("conversion", count, nanosecondsPerCall([&](uint32_t i) {
+        result = sensor->convert(20 * 180 + (i & 15), 20);
+    }), "ns");
+    report("running_average", count, nanosecondsPerCall([&](uint32_t) {
+        result = sensor->getRunningAverage();
+    }), "ns");
+    (void)result;
+
+    delete sensor;
+}
+
+static void benchBlocking(uint16_t numSamples, GP2YDustSensor &sensor)
+{
+    uint64_t start = GP2YHalSim::getTime();
+    sensor.getDustDensity(numSamples);
+    report("blocking", numSamples, GP2YHalSim::getTime() - start, "us");
+}
+
+/**
+ * @return bool true if a deterministic result got worse
+ */
+static bool compare(const char *baselinePath)
+{
+    char name[48], unit[8];
+    double value;
+    bool regression = false;
+    FILE *file = fopen(baselinePath, "r");
+
+    if (!file) {
+        fprintf(stderr, "cannot read %s\n", baselinePath);
+        return true;
+    }
+
+    printf("\n%-28s %12s %12s %8s\n", "result", "baseline", "now", "change");
+    while (fscanf(file, "bench %47s %lf %7s\n", name, &value, unit) == 3) {
+        for (uint8_t i = 0; i < resultCount; i++) {
+            if (strcmp(results[i].name, name)) {
+                continue;
+            }
+
+            double change = value ? (results[i].value - value) / value * 100 : 0;
+            bool deterministic = strcmp(unit, "ns") != 0;
+            bool worse = deterministic && results[i].value > value;
+
+            printf("%-28s %12.1f %12.1f %7.1f%%%s\n", name, value, results[i].value, change, worse ? " REGRESSION" : "");
+            regression = regression || worse;
+        }
+    }
+    fclose(file);
+
+    return regression;
+}
+
+int main(int argc, char **argv)
+{
+    GP2YHalSim::reset();
+
+    report("sizeof_sensor", 0, sizeof(GP2YDustSensor), "bytes");
+    report("sizeof_static_sensor", 60, sizeof(GP2YStaticDustSensor<60>), "bytes");
+
+    for (uint8_t i = 0; i < sizeof(RUNNING_AVERAGE_COUNTS) / sizeof(RUNNING_AVERAGE_COUNTS[0]); i++) {
+        benchRunningAverage(RUNNING_AVERAGE_COUNTS[i]);
+    }
+
+    GP2YDustSensor sensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+    sensor.begin();
+    for (uint8_t i = 0; i < sizeof(SAMPLE_COUNTS) / sizeof(SAMPLE_COUNTS[0]); i++) {
+        benchBlocking(SAMPLE_COUNTS[i], sensor);
+    }
+
+    if (argc > 1) {
+        return compare(argv[1]) ? 1 : 0;
+    }
+
+    for (uint8_t i = 0; i < resultCount; i++) {
+        printf("bench %s %.1f %s\n", results[i].name, results[i].value, results[i].unit);
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+/**
+ * Host simulation of the GP2YDustSensor library, runs simulated days in seconds.
+ * A synthetic sensor (GP2YSignalGenerator) with drifting baseline, noise and spikes
+ * is read once per simulated second, the drift is corrected by a GP2YBaselineTracker
+ * with a 24h window. getBaselineCandidate() is printed every hour for comparison.
+ * Every hour the 1 minute average of a GP2YDustAggregator is checked against the running average
+ * (both cover the last 60 readings).
+ * A second run steps the temperature with the temperature compensation and a 1h baseline tracker attached,
+ * the readings must not move once the tracker has followed the shifted output.
+ * Exits with 1 if the LED pulse timing was wrong, the readings did not follow the signal
+ * or the averages disagreed, for CI.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++11 -O2 -DGP2Y_HAL_SIMULATED -I../.. host_sim.cpp ../../GP2Y*.cpp -o host_sim
+ *   ./host_sim [hours = 48] [seed = 1]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+
+#include "GP2YHal.h"
+#include "GP2YDustSensor.h"
+#include "GP2YBaselineTracker.h"
+#include "GP2YDustAggregator.h"
+#include "GP2YSignalGenerator.h"
+
+const uint8_t SHARP_LED_PIN = 14;
+const uint8_t SHARP_VO_PIN = A0;
+const uint16_t SECONDS_PER_HOUR = 3600;
+
+// clean air at night, polluted during the day
+static float dustProfile(uint32_t hour)
+{
+    return hour % 24 < 6 ? 0 : 30;
+}
+
+/**
+ * Dust for 50 minutes of every hour, the temperature steps from 25C to 45C after 3 hours.
+ * The sensor output follows the temperature, the compensation removes the shift before the density
+ * is computed and before the baseline tracker sees the output, so the tracked baseline must stay
+ * at the reference temperature.
+ *
+ * @param uint32_t seed
+ * @return float mean absolute error of the dusty readings in the last 3 hours
+ */
+static float temperatureStep(uint32_t seed)
+{
+    const float COEFFICIENT = 0.003; // V/C
+    const uint8_t HOURS = 8;
+
+    GP2YHalSim::reset();
+
+    GP2YSignalGenerator signal(seed);
+    signal.setZeroDustVoltage(0.6, 0);
+    signal.setNoise(0.01);
+    signal.setLedPin(SHARP_LED_PIN);
+    GP2YHalSim::setAnalogSource(&signal);
+
+    GP2YDustSensor dustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+    GP2YBaselineTracker baselineTracker(600, 6); // 1h window
+    dustSensor.setBaselineTracker(&baselineTracker);
+    dustSensor.setTemperatureCoefficient(COEFFICIENT, 25);
+    dustSensor.begin();
+    signal.begin();
+
+    float errorSum = 0;
+    uint32_t errorCount = 0;
+
+    for (uint8_t hour = 0; hour < HOURS; hour++) {
+        float temperature = hour < 3 ? 25 : 45;
+        signal.setZeroDustVoltage(0.6 + COEFFICIENT * (temperature - 25), 0);
+        dustSensor.setEnvironment(temperature, 0);
+
+        for (uint16_t second = 0; second < SECONDS_PER_HOUR; second++) {
+            float dust = second < 600 ? 0 : 30;
+            signal.setDustDensity(dust);
+
+            uint64_t readingStart = GP2YHalSim::getTime();
+            uint16_t density = dustSensor.getDustDensity();
+
+            // skip the minute the dust needs to settle in the readings
+            if (hour >= HOURS - 3 && second >= 660) {
+                errorSum += fabs(density - dust);
+                errorCount++;
+            }
+
+            GP2YHalSim::advance(1000000 - (GP2YHalSim::getTime() - readingStart));
+        }
+    }
+
+    return errorCount ? errorSum / errorCount : 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t hours = argc > 1 ? atoi(argv[1]) : 48;
+    uint32_t seed = argc > 2 ? atoi(argv[2]) : 1;
+
+    GP2YHalSim::reset();
+
+    GP2YSignalGenerator signal(seed);
+    signal.setZeroDustVoltage(0.6, 0.0005); // +12mV per day
+    signal.setNoise(0.01);
+    signal.setSpikes(0.001, 0.5);
+    signal.setLedPin(SHARP_LED_PIN);
+    GP2YHalSim::setAnalogSource(&signal);
+
+    GP2YDustSensor dustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN);
+    GP2YBaselineTracker baselineTracker(SECONDS_PER_HOUR, 24);
+    GP2YDustAggregator aggregator(60);
+    dustSensor.setBaselineTracker(&baselineTracker);
+    dustSensor.setAggregator(&aggregator);
+    dustSensor.begin();
+    signal.begin();
+
+    float errorSum = 0;
+    uint32_t errorCount = 0;
+    uint32_t averageMismatches = 0;
+    uint16_t density = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    printf("hour  dust  density  average  zero dust V  baseline V  candidate V\n");
+
+    for (uint32_t hour = 0; hour < hours; hour++) {
+        signal.setDustDensity(dustProfile(hour));
+
+        for (uint16_t second = 0; second < SECONDS_PER_HOUR; second++) {
+            uint64_t readingStart = GP2YHalSim::getTime();
+            density = dustSensor.getDustDensity();
+
+            // the second half of the run checks the corrected readings
+            if (hour >= hours / 2 && second >= SECONDS_PER_HOUR / 2) {
+                errorSum += fabs(density - dustProfile(hour));
+                errorCount++;
+            }
+
+            GP2YHalSim::advance(1000000 - (GP2YHalSim::getTime() - readingStart));
+        }
+
+        // the minutes are kept in 1/16 ug/m3, allow one step of difference
+        int32_t averageDifference = (int32_t)aggregator.getAverageQ8(GP2Y_WINDOW_1_MINUTE) - (int32_t)dustSensor.getRunningAverageQ8();
+        if (abs(averageDifference) > 16) {
+            averageMismatches++;
+        }
+
+        float candidate = dustSensor.getBaselineCandidate();
+        printf("%4u  %4.0f  %7u  %7u  %11.3f  %10.3f  %11.3f\n",
+            hour, dustProfile(hour), density, dustSensor.getRunningAverage(),
+            signal.getZeroDustVoltage(), dustSensor.getBaseline(), candidate);
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t cycles = GP2YHalSim::getAnalogReads();
+    float meanError = errorCount ? errorSum / errorCount : 0;
+
+    printf("\n%u sampling cycles in %.2fs: %.2f million cycles/s\n", cycles, wallSeconds, cycles / wallSeconds / 1e6);
+    printf("mistimed reads: %u\n", signal.getMistimedReads());
+    printf("mean absolute error, second half: %.2f ug/m3\n", meanError);
+    printf("aggregator / running average mismatches: %u\n", averageMismatches);
+
+    float temperatureError = temperatureStep(seed);
+    printf("mean absolute error after a temperature step: %.2f ug/m3\n", temperatureError);
+
+    return signal.getMistimedReads() || meanError > 5 || averageMismatches || temperatureError > 5 ? 1 : 0;
+}
@@ -0,0 +1,419 @@
+/**
+ * Host unit tests of the parts of the library that don't need the sensor timing:
+ * record frames, the flash log (on a RAM storage, through a wrap and a reset),
+ * the aggregator windows, the checksummed save / restore of the states and the interrupt read
+ * function of the ADC sources.
+ * Prints the failed checks and exits with 1 if there are any, for CI.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++11 -O2 -DGP2Y_HAL_SIMULATED -I../.. host_test.cpp ../../GP2Y*.cpp -o host_test
+ *   ./host_test
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "GP2YHal.h"
+#include "GP2YDustSensor.h"
+#include "GP2YDustAggregator.h"
+#include "GP2YBaselineTracker.h"
+#include "GP2YRecordEncoder.h"
+#include "GP2YFlashLog.h"
+#include "GP2YSignalGenerator.h"
+
+const uint8_t SHARP_LED_PIN = 14;
+const uint8_t SHARP_VO_PIN = A0;
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static void check(bool condition, const char *text, int line)
+{
+    checks++;
+
+    if (!condition) {
+        failures++;
+        printf("line %d: %s failed\n", line, text);
+    }
+}
+
+/**
+ * NOR flash like storage in RAM: erase sets 0xFF, write can only clear bits
+ */
+class RamStorage : public GP2YFlashStorage
+{
+    private:
+        static const uint16_t SECTOR_COUNT = 4;
+        static const uint16_t SECTOR_SIZE = 128;
+
+        uint8_t data[SECTOR_COUNT * SECTOR_SIZE];
+
+    public:
+        uint32_t erases;
+
+        RamStorage()
+        {
+            memset(this->data, 0xFF, sizeof(this->data));
+            this->erases = 0;
+        }
+
+        uint16_t getSectorCount()
+        {
+            return SECTOR_COUNT;
+        }
+
+        uint16_t getSectorSize()
+        {
+            return SECTOR_SIZE;
+        }
+
+        bool read(uint32_t address, uint8_t *data, uint16_t size)
+        {
+            if (address + size > sizeof(this->data)) {
+                return false;
+            }
+            memcpy(data, this->data + address, size);
+
+            return true;
+        }
+
+        bool write(uint32_t address, const uint8_t *data, uint16_t size)
+        {
+            if (address + size > sizeof(this->data)) {
+                return false;
+            }
+            for (uint16_t i = 0; i < size; i++) {
+                this->data[address + i] &= data[i];
+            }
+
+            return true;
+        }
+
+        bool erase(uint16_t sector)
+        {
+            if (sector >= SECTOR_COUNT) {
+                return false;
+            }
+            memset(this->data + sector * SECTOR_SIZE, 0xFF, SECTOR_SIZE);
+            this->erases++;
+
+            return true;
+        }
+};
+
+class PlainSource : public GP2YAdcSource
+{
+    public:
+        uint16_t read(uint8_t)
+        {
+            return 100;
+        }
+};
+
+class IsrSource : public PlainSource
+{
+    private:
+        static uint16_t readIsr(GP2YAdcSource *, uint8_t)
+        {
+            return 200;
+        }
+
+    public:
+        GP2YIsrReadFunction getIsrReadFunction()
+        {
+            return &readIsr;
+        }
+};
+
+static GP2YDustRecord makeRecord(uint32_t index)
+{
+    GP2YDustRecord record;
+
+    record.timestamp = 1700000000 + index * 60;
+    record.density = (index * 37) % 500;
+    record.baseline = 600 + index % 7;
+    record.flags = index % 5 == 0 ? 1 : 0;
+
+    return record;
+}
+
+static bool sameRecord(const GP2YDustRecord &a, const GP2YDustRecord &b)
+{
+    return a.timestamp == b.timestamp && a.density == b.density && a.baseline == b.baseline && a.flags == b.flags;
+}
+
+static void testRecords()
+{
+    uint8_t frame[51];
+    GP2YRecordEncoder encoder(frame, sizeof(frame));
+    GP2YDustRecord record;
+    uint8_t count = 0;
+
+    while (encoder.add(makeRecord(count))) {
+        count++;
+    }
+    CHECK(count > 0);
+    CHECK(encoder.getRecordCount() == count);
+    CHECK(encoder.getLength() <= sizeof(frame));
+
+    GP2YRecordDecoder decoder(frame, encoder.getLength());
+    CHECK(decoder.isValid());
+    CHECK(decoder.getRecordCount() == count);
+
+    uint8_t decoded = 0;
+    while (decoder.next(record)) {
+        CHECK(sameRecord(record, makeRecord(decoded)));
+        decoded++;
+    }
+    CHECK(decoded == count);
+
+    // a decreasing timestamp does not fit the delta coding
+    GP2YDustRecord older = makeRecord(0);
+    older.timestamp--;
+    encoder.reset();
+    CHECK(encoder.add(makeRecord(0)));
+    CHECK(!encoder.add(older));
+
+    // a truncated frame stops at the last complete record
+    encoder.reset();
+    CHECK(encoder.add(makeRecord(0)));
+    CHECK(encoder.add(makeRecord(1)));
+    GP2YRecordDecoder truncated(frame, encoder.getLength() - 1);
+    CHECK(truncated.next(record) && sameRecord(record, makeRecord(0)));
+    CHECK(!truncated.next(record));
+
+    frame[0] = GP2YRecordEncoder::FORMAT_VERSION + 1;
+    CHECK(!GP2YRecordDecoder(frame, encoder.getLength()).isValid());
+}
+
+static void testFlashLog()
+{
+    RamStorage storage;
+    GP2YFlashLog log(&storage);
+    GP2YDustRecord record;
+
+    CHECK(log.begin());
+    CHECK(log.getCount() == 0);
+    CHECK(!log.read(record));
+
+    // 10 entries per 128 byte sector, 3 of the 4 sectors are always kept
+    uint32_t capacity = log.getCapacity();
+    CHECK(capacity == 30);
+
+    // wrap around the storage more than twice
+    const uint32_t RECORDS = 100;
+    for (uint32_t i = 0; i < RECORDS; i++) {
+        CHECK(log.append(makeRecord(i)));
+    }
+    CHECK(!log.append(makeRecord(0)));
+    CHECK(log.flush());
+    CHECK(storage.erases > 4);
+
+    uint32_t count = log.getCount();
+    uint32_t first = RECORDS - count;
+    CHECK(count >= capacity && count <= capacity + 10);
+
+    uint32_t index = first;
+    while (log.read(record)) {
+        CHECK(sameRecord(record, makeRecord(index)));
+        index++;
+    }
+    CHECK(index == RECORDS);
+
+    // the log is found again after a reset, and keeps its sequence
+    GP2YFlashLog restarted(&storage);
+    CHECK(restarted.begin());
+    CHECK(restarted.getCount() == count);
+    CHECK(restarted.read(record) && sameRecord(record, makeRecord(first)));
+    CHECK(!restarted.append(makeRecord(RECORDS - 2)));
+
+    for (uint32_t i = RECORDS; i < RECORDS + 25; i++) {
+        CHECK(restarted.append(makeRecord(i)));
+    }
+    CHECK(restarted.flush());
+
+    GP2YFlashLog again(&storage);
+    CHECK(again.begin());
+    count = again.getCount();
+    first = RECORDS + 25 - count;
+    CHECK(count >= capacity && count <= capacity + 10);
+
+    index = first;
+    while (again.read(record)) {
+        CHECK(sameRecord(record, makeRecord(index)));
+        index++;
+    }
+    CHECK(index == RECORDS + 25);
+
+    // seek to an exact timestamp and between two records
+    uint32_t target = first + count / 2;
+    CHECK(again.seek(makeRecord(target).timestamp));
+    CHECK(again.read(record) && sameRecord(record, makeRecord(target)));
+    CHECK(again.seek(makeRecord(target).timestamp + 1));
+    CHECK(again.read(record) && sameRecord(record, makeRecord(target + 1)));
+    CHECK(again.getRemaining() == RECORDS + 25 - target - 2);
+    CHECK(again.seek(0));
+    CHECK(again.read(record) && sameRecord(record, makeRecord(first)));
+    CHECK(!again.seek(makeRecord(RECORDS + 25).timestamp));
+
+    CHECK(again.clear());
+    CHECK(again.getCount() == 0);
+}
+
+static void testAggregator()
+{
+    const uint16_t READINGS_PER_MINUTE = 4;
+    GP2YDustAggregator aggregator(READINGS_PER_MINUTE);
+
+    CHECK(aggregator.getAverage(GP2Y_WINDOW_24_HOURS) == 0);
+
+    // the first hour at 10 ug/m3, the rest of the day at 20.5 ug/m3
+    for (uint32_t i = 0; i < READINGS_PER_MINUTE * 60; i++) {
+        aggregator.addReading(10);
+        if (i == 1) {
+            // partial minute
+            CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_1_MINUTE) == 10 << 8);
+            CHECK(!aggregator.isWindowFull(GP2Y_WINDOW_1_MINUTE));
+        }
+    }
+    CHECK(aggregator.isWindowFull(GP2Y_WINDOW_1_HOUR));
+    CHECK(!aggregator.isWindowFull(GP2Y_WINDOW_24_HOURS));
+    CHECK(aggregator.getAverage(GP2Y_WINDOW_1_HOUR) == 10);
+    CHECK(aggregator.getAverage(GP2Y_WINDOW_24_HOURS) == 10);
+
+    for (uint32_t i = 0; i < READINGS_PER_MINUTE * 60 * 23; i++) {
+        aggregator.addReadingQ8(20 * 256 + 128);
+    }
+    CHECK(aggregator.isWindowFull(GP2Y_WINDOW_24_HOURS));
+    CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_1_MINUTE) == 20 * 256 + 128);
+    CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_15_MINUTES) == 20 * 256 + 128);
+    CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_1_HOUR) == 20 * 256 + 128);
+    // (10 + 23 * 20.5) / 24 = 20.0625
+    CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_24_HOURS) == (10 * 256 + 23 * (20 * 256 + 128)) / 24);
+
+    // 15 minutes later the quarter has moved on, the hour has not
+    for (uint32_t i = 0; i < READINGS_PER_MINUTE * 15; i++) {
+        aggregator.addReading(40);
+    }
+    CHECK(aggregator.getAverage(GP2Y_WINDOW_15_MINUTES) == 40);
+    CHECK(aggregator.getAverageQ8(GP2Y_WINDOW_1_HOUR) == (45 * (20 * 256 + 128) + 15 * 40 * 256) / 60);
+
+    aggregator.reset();
+    CHECK(aggregator.getAverage(GP2Y_WINDOW_1_HOUR) == 0);
+    CHECK(!aggregator.isWindowFull(GP2Y_WINDOW_1_MINUTE));
+}
+
+static void testAggregatorState()
+{
+    GP2YDustAggregator aggregator(4);
+    uint8_t buffer[512];
+
+    for (uint32_t i = 0; i < 4 * 90; i++) {
+        aggregator.addReading(i % 50);
+    }
+
+    uint16_t size = aggregator.saveState(buffer, sizeof(buffer));
+    CHECK(size == aggregator.getStateSize());
+    CHECK(aggregator.saveState(buffer, size - 1) == 0);
+
+    GP2YDustAggregator restored(4);
+    CHECK(restored.restoreState(buffer, size));
+    CHECK(restored.getAverageQ8(GP2Y_WINDOW_24_HOURS) == aggregator.getAverageQ8(GP2Y_WINDOW_24_HOURS));
+    CHECK(restored.getAverageQ8(GP2Y_WINDOW_1_HOUR) == aggregator.getAverageQ8(GP2Y_WINDOW_1_HOUR));
+
+    GP2YDustAggregator other(60);
+    CHECK(!other.restoreState(buffer, size));
+    CHECK(!restored.restoreState(buffer, size - 1));
+
+    buffer[size - 1] ^= 1;
+    CHECK(!GP2YDustAggregator(4).restoreState(buffer, size));
+}
+
+static void testTrackerState()
+{
+    GP2YBaselineTracker tracker(10, 6);
+    uint8_t buffer[256];
+
+    for (uint32_t i = 0; i < 45; i++) {
+        tracker.addReading(1000 + (i * 7) % 13, true);
+    }
+    CHECK(tracker.hasBaseline());
+
+    uint16_t size = tracker.saveState(buffer, sizeof(buffer));
+    CHECK(size == tracker.getStateSize());
+
+    GP2YBaselineTracker restored(10, 6);
+    CHECK(restored.restoreState(buffer, size));
+    CHECK(restored.getBaseline() == tracker.getBaseline());
+
+    GP2YBaselineTracker otherBuckets(10, 5);
+    CHECK(!otherBuckets.restoreState(buffer, size));
+
+    buffer[size / 2] ^= 1;
+    CHECK(!GP2YBaselineTracker(10, 6).restoreState(buffer, size));
+}
+
+static void testAdcSource()
+{
+    PlainSource plain;
+    IsrSource isr;
+
+    CHECK(!plain.isIsrSafe());
+    CHECK(plain.getIsrReadFunction() == NULL);
+    CHECK(isr.isIsrSafe());
+    CHECK(isr.getIsrReadFunction() && isr.getIsrReadFunction()(&isr, 0) == 200);
+}
+
+static void testSensorState()
+{
+    GP2YHalSim::reset();
+
+    GP2YSignalGenerator signal(1);
+    signal.setZeroDustVoltage(0.6, 0);
+    signal.setDustDensity(25);
+    signal.setNoise(0.01);
+    GP2YHalSim::setAnalogSource(&signal);
+
+    GP2YDustSensor dustSensor(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, 10);
+    dustSensor.begin();
+    signal.begin();
+
+    for (uint8_t i = 0; i < 15; i++) {
+        dustSensor.getDustDensity();
+    }
+
+    uint8_t buffer[256];
+    uint16_t size = dustSensor.saveState(buffer, sizeof(buffer));
+    CHECK(size > 0 && size == dustSensor.getStateSize());
+
+    GP2YDustSensor restored(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, 10);
+    restored.begin();
+    CHECK(restored.restoreState(buffer, size));
+    CHECK(restored.getRunningAverageQ8() == dustSensor.getRunningAverageQ8());
+    CHECK(restored.getBaseline() == dustSensor.getBaseline());
+
+    GP2YDustSensor otherAverage(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, 20);
+    otherAverage.begin();
+    CHECK(!otherAverage.restoreState(buffer, size));
+
+    buffer[size - 1] ^= 1;
+    GP2YDustSensor corrupted(GP2Y1014AU0F, SHARP_LED_PIN, SHARP_VO_PIN, 10);
+    corrupted.begin();
+    CHECK(!corrupted.restoreState(buffer, size));
+}
+
+int main()
+{
+    testRecords();
+    testFlashLog();
+    testAggregator();
+    testAggregatorState();
+    testTrackerState();
+    testAdcSource();
+    testSensorState();
+
+    printf("%u checks, %u failed\n", checks, failures);
+
+    return failures ? 1 : 0;
+}